@@ -0,0 +1,96 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <string>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_plan.h"
+#include "sort_types.h"
+
+/**
+ * Startup self-tuning: algorithm and parameters from an alpha-beta model
+ *
+ * Algorithm:
+ * 1. Probe (all ranks at once, so oversubscription shows up): ping-pong
+ *    between rank pairs for the message latency (alpha) and the time per
+ *    byte (beta); a local sort and a two-way merge of a probe block for
+ *    their cost per element, with one thread and with every core the
+ *    rank's share of the node allows. Each figure is the slowest rank's.
+ * 2. Model, for n elements over p ranks (m = n/p per rank, b bytes each):
+ *    PSRS with k-fold oversampling costs the local sort, the sample gather
+ *    and root sort of k p^2 samples, an all-to-all of (p-1) alpha +
+ *    f m b beta, and a log2(p)-way merge of f m elements, where
+ *    f = 1 + 1/k bounds the largest output. Bitonic costs the local sort
+ *    plus log2(p)(log2(p)+1)/2 steps of alpha + m b beta and a merge of m,
+ *    which a pipeline of chunk c overlaps at m/c latencies per step.
+ * 3. The cheapest combination of algorithm, oversampling, pipeline chunk
+ *    and thread count is chosen
+ *
+ * The probe result is cached as one line per element type in
+ * <cache_dir>/<host>_n<nodes>_p<ranks>.tune, so later runs on the same
+ * machine and rank count skip step 1; the model runs for every n.
+ */
+
+// Probe measurements; times in seconds, the slowest rank's
+struct MachineProfile {
+    double latency;         // One-way small-message time (alpha)
+    double byte_time;       // Transfer time per byte (beta)
+    double sort_time;       // Local sort per element per log2 of the block, one thread
+    double merge_time;      // Two-way merge per output element, one thread
+    int cores_per_rank;     // Hardware threads per rank on the fullest node
+    double thread_speedup;  // Local sort speedup with cores_per_rank threads
+
+    MachineProfile() : latency(0), byte_time(0), sort_time(0), merge_time(0),
+                       cores_per_rank(1), thread_speedup(1) {}
+};
+
+// What the tuner may choose from, and where it caches probes
+struct TuningOptions {
+    bool allow_bitonic;     // False when other options need PSRS
+    bool allow_pipeline;    // False when the exchange cannot be chunked
+    bool reprobe;           // Ignore a cached probe and overwrite it
+    std::string cache_dir;  // Empty: never read or write the cache
+
+    TuningOptions() : allow_bitonic(true), allow_pipeline(true), reprobe(false) {}
+};
+
+// The chosen algorithm and parameters, with the model's estimates
+struct TuningDecision {
+    SortAlgorithm algorithm;
+    int oversampling;
+    size_t pipeline_chunk;
+    int threads_per_rank;
+    double psrs_estimate;       // Seconds, best PSRS parameters
+    double bitonic_estimate;    // Seconds, best bitonic parameters; 0 if not allowed
+    bool from_cache;            // The probe was read from the cache
+    double probe_time;          // Seconds spent probing (0 from the cache)
+    MachineProfile profile;
+
+    TuningDecision() : algorithm(SortAlgorithm::Psrs), oversampling(1), pipeline_chunk(0),
+                       threads_per_rank(1), psrs_estimate(0), bitonic_estimate(0),
+                       from_cache(false), probe_time(0) {}
+};
+
+// Step 1 for elements of type T with the given local sort engine.
+// Collective over comm.
+template <typename T>
+MachineProfile probe_machine(MPI_Comm comm, LocalSortEngine engine);
+
+// Steps 2-3 for n elements of element_bytes over size ranks
+TuningDecision choose_parameters(const MachineProfile& profile, long long n,
+                                 size_t element_bytes, int size,
+                                 const TuningOptions& options);
+
+// Cached or fresh probe, then the model; every rank gets the same
+// decision. Collective over comm.
+template <typename T>
+TuningDecision autotune(long long n, MPI_Comm comm, LocalSortEngine engine,
+                        const TuningOptions& options);
+
+// Apply a decision's parameters to a sort configuration
+void apply_decision(const TuningDecision& decision, SortConfig& config);
+
+// $XDG_CACHE_HOME/parallel_sort, else $HOME/.cache/parallel_sort
+std::string default_tuning_cache_dir();
+
+#endif // AUTOTUNE_H
@@ -4,38 +4,110 @@
 #include <vector>
 #include <mpi.h>
 #include "utils.h"
+#include "thread_pool.h"
+#include "sort_types.h"
 
 /**
  * Bitonic Sort (Network-based algorithm)
  * 
  * Algorithm:
  * 1. Each rank sorts its local data
- * 2. Perform log²(p) compare-exchange stages
- * 3. In each stage, pairs of ranks exchange data and keep appropriate half
- * 4. Build bitonic sequences and repeatedly merge them
+ * 2. Every block counts as the largest block size, topped up with virtual
+ *    +inf padding that is never stored or sent
+ * 3. Perform log²(P) compare-exchange stages, P = p rounded up to a power of 2
+ * 4. In each stage, pairs of ranks exchange data and keep appropriate part;
+ *    the lower rank always keeps the smaller half
+ * 5. Ranks p..P-1 are virtual (all +inf), so steps pairing with them are
+ *    no-ops and are skipped
  * 
  * Communication: Pairwise exchanges (MPI_Sendrecv)
- * Works best when p is power of 2
+ * Any p works; non-power-of-2 p pays for the larger network with idle steps
+ * (timing.idle_steps), and uneven inputs end with uneven output counts
  * Regular communication pattern, good for low-latency networks
  * Time: O((n/p)log(n/p)) local + O(log²p) network stages
+ *
+ * With config.threads_per_rank > 1 the local sort and the merges of each
+ * compare-exchange are split across the rank's thread pool. The pipelined
+ * exchange (config.pipeline_chunk > 0) merges on the calling thread.
+ * With config.exchange == ExchangeMethod::Shared (single node) blocks stay
+ * in a shared-memory window and partners merge out of each other's memory.
+ *
+ * T is any type from FOR_EACH_SORT_TYPE (sort_types.h); key+payload
+ * records use the array-of-structs layout.
  */
-void bitonic_sort(std::vector<int>& local_data,
+template <typename T>
+void bitonic_sort(std::vector<T>& local_data,
                   int rank,
                   int size,
                   MPI_Comm comm,
-                  TimingData& timing);
+                  TimingData& timing,
+                  const SortConfig& config = SortConfig());
+
+// Scratch space reused by every compare-exchange of one bitonic_sort() call,
+// or of many calls when the caller keeps it (sort_plan.h)
+template <typename T>
+struct BitonicBuffers {
+    std::vector<T> partner;     // Partner's block as received
+    std::vector<T> kept;        // Merge output, swapped with the local block
+};
+
+// bitonic_sort() with caller-owned scratch buffers
+template <typename T>
+void bitonic_sort(std::vector<T>& local_data,
+                  int rank,
+                  int size,
+                  MPI_Comm comm,
+                  TimingData& timing,
+                  const SortConfig& config,
+                  BitonicBuffers<T>& buffers);
 
 // Helper functions
-void compare_exchange(std::vector<int>& local_data,
+
+// Exchanges boundary elements first and skips the block transfer and merge
+// when the two ranks are already ordered. Blocks shorter than block_size
+// carry virtual +inf padding: the low side keeps the block_size smallest
+// keys of the pair and the high side the rest. With pipeline_chunk > 0 the
+// block moves in chunks of that many elements (MPI_Isend/MPI_Irecv) and
+// each chunk is merged while the next one is in flight; merge time spent
+// with chunks outstanding is added to timing.overlap_time.
+template <typename T>
+void compare_exchange(std::vector<T>& local_data,
                      int partner_rank,
                      bool keep_small,
-                     int rank,
                      MPI_Comm comm,
-                     double& comm_time);
+                     TimingData& timing,
+                     ThreadPool& pool,
+                     BitonicBuffers<T>& buffers,
+                     size_t block_size,
+                     size_t pipeline_chunk = 0);
 
-void merge_high(std::vector<int>& data, const std::vector<int>& received);
-void merge_low(std::vector<int>& data, const std::vector<int>& received);
+// Merge only the keep elements that are kept into scratch (the largest,
+// from the back, for high; the smallest, from the front, for low), then
+// swap them into data
+template <typename T>
+void merge_high(std::vector<T>& data, const std::vector<T>& received, size_t keep,
+                std::vector<T>& scratch, ThreadPool& pool);
+template <typename T>
+void merge_low(std::vector<T>& data, const std::vector<T>& received, size_t keep,
+               std::vector<T>& scratch, ThreadPool& pool);
 
 bool is_power_of_two(int n);
 
+// Smallest k with 2^k >= n: the stages of the network over n ranks
+inline int ceil_log2(int n) {
+    int levels = 0;
+    while ((1 << levels) < n) levels++;
+    return levels;
+}
+
+// Partner of rank at one step of the network: the first step of each stage
+// pairs ranks mirrored in a block of 2^(stage+1), later steps ranks 2^step
+// apart; the lower rank of a pair always keeps the smaller half
+inline int network_partner(int rank, int stage, int step) {
+    if (step == stage) {
+        return rank ^ ((1 << (stage + 1)) - 1);
+    }
+    return rank ^ (1 << step);
+}
+
 #endif // BITONIC_SORT_H
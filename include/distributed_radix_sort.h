@@ -0,0 +1,48 @@
+#ifndef DISTRIBUTED_RADIX_SORT_H
+#define DISTRIBUTED_RADIX_SORT_H
+
+#include <vector>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Distributed MSD radix sort
+ *
+ * Algorithm:
+ * 1. MPI_Allreduce finds the smallest and largest mapped key (radix_key in
+ *    radix_sort.h); the top digit is taken from the highest bit where they
+ *    differ, so narrow key ranges still spread over all digits
+ * 2. Each rank counts its keys per top digit (up to 2^16 digits) and
+ *    MPI_Allreduce sums the counts into the global histogram
+ * 3. From its prefix sums every rank gets a contiguous digit range whose
+ *    boundaries lie nearest to multiples of n/p
+ * 4. One counting-sort pass orders the local data by top digit, which
+ *    groups it by destination rank
+ * 5. One all-to-all exchange (alltoallv_exchange, any config.exchange)
+ * 6. Each rank scatters what it received by top digit, at offsets known
+ *    from the global histogram, and LSD radix sorts every digit's bucket
+ *    on the remaining bits; digits the bucket shares are skipped
+ *
+ * No comparisons, no samples and no k-way merge. Balance depends on the
+ * key distribution: one digit holding more than n/p keys lands on one
+ * rank, so heavy duplicates unbalance the output. If every key is equal
+ * the data is left where it is.
+ *
+ * In timing, local_sort holds steps 2 and 4, comm the collectives and the
+ * exchange, and merge step 6 (the finishing sort). With
+ * config.threads_per_rank > 1 the buckets of step 6 are sorted on the
+ * rank's thread pool.
+ *
+ * T is any type from FOR_EACH_SORT_TYPE (sort_types.h); floating-point
+ * keys sort in the order of radix_key.
+ */
+template <typename T>
+void distributed_radix_sort(std::vector<T>& local_data,
+                            int rank,
+                            int size,
+                            MPI_Comm comm,
+                            TimingData& timing,
+                            const SortConfig& config = SortConfig());
+
+#endif // DISTRIBUTED_RADIX_SORT_H
@@ -0,0 +1,53 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Out-of-core PSRS for data larger than memory
+ *
+ * Algorithm:
+ * 1. Run formation: the rank's input file is read in runs of
+ *    run_elements(config) elements; each run is sorted, regularly sampled
+ *    and spilled to its own file with one sequential write
+ * 2. Samples of every run are gathered at the root, which picks p-1 pivots
+ *    tagged with (key, run, index) so duplicates can be cut anywhere
+ * 3. Exchange, one run per round: each rank reads its next run back,
+ *    splits it at the pivots and MPI_Alltoallv's the pieces; the p pieces
+ *    received are merged and spilled as a run of the rank's key range.
+ *    A rank accepts at most run_elements(config) elements per exchange;
+ *    when skew sends it more, the rest follows in further exchanges of
+ *    the round, each spilled as its own run
+ * 4. Final merge: the received runs stream through a k-way merge with one
+ *    block buffer per run into output_path; with more runs than buffers fit
+ *    the budget, intermediate passes first merge groups of runs
+ *
+ * Peak memory is about config.memory_budget: one run, the pieces received
+ * for it and their merge. Spill files live in config.spill_dir and are
+ * removed once consumed. Files hold raw arrays of T.
+ * Returns the number of elements written to output_path.
+ */
+template <typename T>
+size_t external_sort(const std::string& input_path,
+                     const std::string& output_path,
+                     int rank,
+                     int size,
+                     MPI_Comm comm,
+                     TimingData& timing,
+                     const SortConfig& config);
+
+// Elements per run: a third of the memory budget
+template <typename T>
+size_t run_elements(const SortConfig& config);
+
+// Stream a file written by external_sort and check that it is sorted and
+// that its first element is not below the last element of the nearest
+// non-empty lower rank. Collective over comm.
+template <typename T>
+bool verify_sorted_file(const std::string& path, int rank, int size, MPI_Comm comm);
+
+#endif // EXTERNAL_SORT_H
@@ -0,0 +1,53 @@
+#ifndef HIERARCHICAL_EXCHANGE_H
+#define HIERARCHICAL_EXCHANGE_H
+
+#include <vector>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Two-level all-to-all through one leader rank per shared-memory node
+ *
+ * Algorithm:
+ * 1. Ranks are grouped by MPI_Comm_split_type(MPI_COMM_TYPE_SHARED); the
+ *    lowest rank of every node is its leader
+ * 2. Every rank gathers its whole send buffer onto its leader, which
+ *    regroups the buckets by destination node
+ * 3. Leaders exchange one aggregated block per node pair with
+ *    MPI_Alltoallv, so only (p/ranks per node)^2 messages cross nodes
+ * 4. Each leader reorders what it received by source rank and scatters
+ *    every member's receive buffer to it
+ *
+ * The result is identical to MPI_Alltoallv: the run from source rank r
+ * lands at recv_displs[r]. Both layouts must be contiguous in rank order
+ * (displs are the prefix sums of counts). The node grouping is cached on
+ * comm, so only the first call pays for the communicator splits. When any
+ * node's aggregate exceeds one int-count call, all ranks fall back to
+ * large_alltoallv (large_count.h).
+ */
+template <typename T>
+void hierarchical_alltoallv(const T* send_buffer,
+                            const std::vector<long long>& send_counts,
+                            const std::vector<long long>& send_displs,
+                            T* recv_buffer,
+                            const std::vector<long long>& recv_counts,
+                            const std::vector<long long>& recv_displs,
+                            MPI_Comm comm);
+
+// large_alltoallv (large_count.h), hierarchical_alltoallv or
+// shared_alltoallv (shared_window.h), as selected by method
+template <typename T>
+void alltoallv_exchange(const T* send_buffer,
+                        const std::vector<long long>& send_counts,
+                        const std::vector<long long>& send_displs,
+                        T* recv_buffer,
+                        const std::vector<long long>& recv_counts,
+                        const std::vector<long long>& recv_displs,
+                        MPI_Comm comm,
+                        ExchangeMethod method);
+
+// Number of shared-memory nodes spanned by comm. Collective over comm.
+int shared_memory_nodes(MPI_Comm comm);
+
+#endif // HIERARCHICAL_EXCHANGE_H
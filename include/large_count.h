@@ -0,0 +1,48 @@
+#ifndef LARGE_COUNT_H
+#define LARGE_COUNT_H
+
+#include <vector>
+#include <mpi.h>
+#include "sort_types.h"
+
+/**
+ * Exchanges whose element counts and displacements may exceed INT_MAX
+ *
+ * Counts and displacements are 64-bit and in elements of T. With an MPI-4
+ * library the MPI_*_c large-count routines carry them directly. Otherwise
+ * calls whose counts all fit in an int use the plain routines, and larger
+ * ones fall back to point-to-point transfers split into messages of at
+ * most INT_MAX elements, addressed by pointer so no displacement is
+ * narrowed. Every rank of comm takes the same path.
+ */
+
+// MPI_Alltoallv with 64-bit counts and displacements
+template <typename T>
+void large_alltoallv(const T* send_buffer,
+                     const std::vector<long long>& send_counts,
+                     const std::vector<long long>& send_displs,
+                     T* recv_buffer,
+                     const std::vector<long long>& recv_counts,
+                     const std::vector<long long>& recv_displs,
+                     MPI_Comm comm);
+
+// MPI_Sendrecv of send_count elements for recv_count elements; both sides
+// must pass the same pair of counts (mirrored)
+template <typename T>
+void large_sendrecv(const T* send_buffer, size_t send_count,
+                    T* recv_buffer, size_t recv_count,
+                    int partner, int tag, MPI_Comm comm);
+
+// Largest element count sent in one int-count MPI call (INT_MAX unless the
+// build overrides MAX_MESSAGE_ELEMENTS)
+size_t max_message_elements();
+
+// True on every rank when every count and displacement of every rank fits
+// in a single int-count call. Collective over comm.
+bool counts_fit_int(const std::vector<long long>& send_counts,
+                    const std::vector<long long>& send_displs,
+                    const std::vector<long long>& recv_counts,
+                    const std::vector<long long>& recv_displs,
+                    MPI_Comm comm);
+
+#endif // LARGE_COUNT_H
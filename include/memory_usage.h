@@ -0,0 +1,53 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+
+/**
+ * Heap and resident memory accounting per rank
+ *
+ * The benchmark links heap_hooks.cpp, which replaces the global operator
+ * new and delete, so every C++ allocation of the process (std::vector
+ * storage included) updates three counters: live bytes, the peak of live
+ * bytes, and bytes allocated in total. Sizes are malloc_usable_size() of
+ * each block, so allocator rounding is counted. Memory MPI allocates with
+ * malloc is not; the resident set size from /proc covers it. Programs
+ * using the library without the hooks read the heap counters as 0.
+ *
+ * Intervals nest: heap_begin_interval() restarts the peak at the current
+ * live bytes and returns the enclosing interval's peak, which
+ * heap_end_interval() folds back in, so an outer interval's peak still
+ * covers everything inside it. Phase Timers (utils.h) use this to record
+ * the peak of every phase.
+ */
+
+// Bytes currently allocated, the most ever live at once, and the running
+// total of bytes allocated
+size_t heap_live_bytes();
+size_t heap_peak_bytes();
+size_t heap_allocated_bytes();
+
+// Restart the peak at the current live bytes
+void heap_reset_peak();
+
+// Start a nested peak measurement; pass the result to heap_end_interval(),
+// which returns the peak since the matching begin
+size_t heap_begin_interval();
+size_t heap_end_interval(size_t enclosing_peak);
+
+// Account one allocated or freed block (heap_hooks.cpp)
+void heap_record_allocation(size_t bytes);
+void heap_record_free(size_t bytes);
+
+// Resident set size high-water mark of the process (VmHWM), 0 if unknown
+size_t peak_rss_bytes();
+
+// Restart the high-water mark at the current RSS (Linux 4.0+, writes
+// /proc/self/clear_refs); false if the kernel refuses
+bool reset_peak_rss();
+
+// Ask for transparent huge pages on the whole pages of a buffer
+// (madvise MADV_HUGEPAGE); a no-op where THP is disabled
+void advise_huge_pages(void* data, size_t bytes);
+
+#endif // MEMORY_USAGE_H
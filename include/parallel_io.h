@@ -0,0 +1,34 @@
+#ifndef PARALLEL_IO_H
+#define PARALLEL_IO_H
+
+#include <vector>
+#include <string>
+#include <mpi.h>
+#include "sort_types.h"
+
+/**
+ * Collective MPI-IO on raw binary element files
+ *
+ * Files hold a plain array of T with no header. Every rank takes part in
+ * every call; reads and writes use MPI_File_read_at_all/write_at_all at
+ * per-rank offsets, issued in chunks of at most 1 GiB so the int counts
+ * never overflow.
+ */
+
+// Size of a file in bytes, or -1 if it cannot be opened
+MPI_Offset binary_file_size(const std::string& path, MPI_Comm comm);
+
+// Read data.size() elements starting at element first_element of the file.
+// Returns false on any rank's failure.
+template <typename T>
+bool read_binary_input(const std::string& path, std::vector<T>& data,
+                       size_t first_element, MPI_Comm comm);
+
+// Write every rank's data back to back in rank order, at offsets from an
+// exclusive scan of the local sizes; an existing file is truncated.
+// Returns false on any rank's failure.
+template <typename T>
+bool write_binary_output(const std::string& path, const std::vector<T>& data,
+                         MPI_Comm comm);
+
+#endif // PARALLEL_IO_H
@@ -0,0 +1,39 @@
+#ifndef PARALLEL_KERNELS_H
+#define PARALLEL_KERNELS_H
+
+#include <vector>
+#include <cstddef>
+#include "thread_pool.h"
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Intra-rank parallel kernels for the hybrid MPI+threads mode
+ *
+ * All kernels fall back to the sequential version when the pool has a
+ * single thread, so the pure-MPI path is unchanged.
+ */
+
+// Chunked sort per thread with the selected engine, followed by pairwise
+// merge-path merges
+template <typename T>
+void parallel_sort(std::vector<T>& data, ThreadPool& pool,
+                   LocalSortEngine engine = LocalSortEngine::StdSort);
+
+// Merge-path co-rank: number of elements taken from a among the first k
+// elements of merge(a, b), with ties resolved in favor of a
+template <typename T>
+size_t merge_path_split(const T* a, size_t na,
+                        const T* b, size_t nb,
+                        size_t k);
+
+// Write ranks [out_begin, out_begin + out_count) of merge(a, b) to out,
+// splitting the output evenly across the pool
+template <typename T>
+void parallel_merge_range(const T* a, size_t na,
+                          const T* b, size_t nb,
+                          size_t out_begin, size_t out_count,
+                          T* out,
+                          ThreadPool& pool);
+
+#endif // PARALLEL_KERNELS_H
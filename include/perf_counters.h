@@ -0,0 +1,60 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/**
+ * Hardware performance counters per sort phase (Linux perf_event_open)
+ *
+ * perf_counters_open() starts one user-space counter per event for the
+ * whole process. Threads created afterwards, such as the rank's thread
+ * pool, are counted too, so it must run before the first sort. A Timer
+ * given a PerfCounts adds the counter deltas between its start() and
+ * stop() to it, so every phase timer also counts its phase.
+ *
+ * Events the CPU or kernel does not offer (no PMU in a VM,
+ * perf_event_paranoid > 2) read as 0. When the PMU multiplexes events,
+ * the values are scaled by time enabled / time running.
+ */
+
+// Events, in the order of PerfCounts::values
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    NUM_PERF_EVENTS
+};
+
+struct PerfCounts {
+    long long values[NUM_PERF_EVENTS];
+    
+    PerfCounts() : values() {}
+    
+    PerfCounts& operator+=(const PerfCounts& other) {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) values[e] += other.values[e];
+        return *this;
+    }
+    
+    PerfCounts& operator-=(const PerfCounts& other) {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) values[e] -= other.values[e];
+        return *this;
+    }
+};
+
+// Open every event; returns how many could be opened (0 if none)
+int perf_counters_open();
+void perf_counters_close();
+
+// True between a perf_counters_open() that opened any event and close
+bool perf_counters_enabled();
+
+// Whether one event was opened
+bool perf_event_available(int event);
+
+// Current process-wide counts (0 for unavailable events)
+PerfCounts perf_counters_read();
+
+// CSV column suffix for an event: cycles, instructions, llc_misses, ...
+const char* perf_event_name(int event);
+
+#endif // PERF_COUNTERS_H
@@ -1,41 +1,204 @@
 #ifndef PSRS_SORT_H
 #define PSRS_SORT_H
 
+#include <memory>
 #include <vector>
 #include <mpi.h>
 #include "utils.h"
+#include "thread_pool.h"
+#include "shared_window.h"
+#include "sort_types.h"
 
 /**
  * PSRS - Parallel Sorting by Regular Sampling
  * 
  * Algorithm:
  * 1. Each rank sorts its local data
- * 2. Select w regular samples from each rank (w = p)
+ * 2. Select w regular samples from each rank (w = config.oversampling * p)
  * 3. Gather all samples at root, sort, and select p-1 pivots
  * 4. Broadcast pivots to all ranks
- * 5. Each rank partitions its data based on pivots into p buckets
- * 6. All-to-all exchange (MPI_Alltoallv) to redistribute data
- * 7. Each rank merges received partitions
+ *    With config.splitters == SplitterMethod::Distributed, steps 3-4 run
+ *    without a root instead: a bitonic network over the ranks sorts the
+ *    samples, each rank picks the pivots that fall in its slice, and one
+ *    MPI_Allgatherv shares them. The pivots are the same either way.
+ * 5. Each rank finds the p-1 pivot offsets in its sorted data
+ * 6. All-to-all exchange (MPI_Alltoallv) sends straight out of the local data;
+ *    with config.exchange == ExchangeMethod::Hierarchical it goes through
+ *    one leader per node instead (hierarchical_exchange.h), and with
+ *    ExchangeMethod::Shared step 7 merges straight out of the peers'
+ *    blocks in a shared-memory window (shared_window.h)
+ * 7. Each rank merges the received runs in place of its input (loser tree)
+ *    With config.low_memory it frees the input once the exchange is done
+ *    and merges the runs pairwise inside the receive buffer instead,
+ *    through copies of the shorter run of each pair. Peak memory drops
+ *    from input + receive buffer + output to about twice the input, at
+ *    the cost of log p passes over the data instead of one.
+ * 8. Optionally (config.exact_rebalance) a second MPI_Alltoallv moves the
+ *    sorted output so every rank holds exactly its input count
  * 
  * Communication: MPI_Gather, MPI_Bcast, MPI_Alltoallv
  * Often has best practical scaling for large p
+ *
+ * Regular sampling bounds each rank's output at about 2n/p. With
+ * config.splitters == SplitterMethod::Histogram, steps 2-5 are replaced by
+ * histogram refinement (splitters.h), which keeps every output within
+ * config.balance_tolerance * n/p of n/p even on skewed keys.
+ *
+ * With config.threads_per_rank > 1 the local sort and merge run on the
+ * rank's thread pool; MPI calls stay on the calling thread.
+ *
+ * T is any type from FOR_EACH_SORT_TYPE (sort_types.h); key+payload
+ * records use the array-of-structs layout and move as one element.
  */
-void psrs_sort(std::vector<int>& local_data,
+template <typename T>
+void psrs_sort(std::vector<T>& local_data,
                int rank,
                int size,
                MPI_Comm comm,
-               TimingData& timing);
+               TimingData& timing,
+               const SortConfig& config = SortConfig());
+
+/**
+ * PSRS for key+payload data in struct-of-arrays layout
+ *
+ * keys[i] and payloads[i] form one element. Sampling, pivots, partitioning
+ * and the merge comparisons touch only the keys; payloads are permuted once
+ * after the local sort, sent in a second MPI_Alltoallv with the same
+ * counts, and copied alongside their keys in the final merge.
+ * Instantiated for 64-bit keys with row-ID and Record64 payloads.
+ */
+template <typename K, typename P>
+void psrs_sort_soa(std::vector<K>& keys,
+                   std::vector<P>& payloads,
+                   int rank,
+                   int size,
+                   MPI_Comm comm,
+                   TimingData& timing,
+                   const SortConfig& config = SortConfig());
+
+/**
+ * Pivot tagged with the position of the sample it came from
+ *
+ * Pivots order by (key, rank, index), where index is the sample's position
+ * in its rank's sorted data, which makes every element distinct. A run of
+ * equal keys can then be cut between ranks, or inside one rank's block,
+ * so a single hot key cannot collapse onto one rank.
+ */
+template <typename T>
+struct TaggedPivot {
+    T value;
+    int rank;
+    long long index;
+};
+
+template <typename T>
+inline bool operator<(const TaggedPivot<T>& a, const TaggedPivot<T>& b) {
+    if (a.value < b.value) return true;
+    if (b.value < a.value) return false;
+    if (a.rank != b.rank) return a.rank < b.rank;
+    return a.index < b.index;
+}
+
+/**
+ * Buffers and splitters that outlive one psrs_sort() call
+ *
+ * A SortPlan (sort_plan.h) keeps one across calls. The count arrays,
+ * receive buffer and merge output keep their capacity, so repeated calls
+ * on similar data allocate nothing. With reuse_splitters, the pivots of
+ * the last sampled selection are tried first. They are kept when no rank
+ * would receive more, as a multiple of n/p, than when they were chosen
+ * (or than 1 + config.balance_tolerance); otherwise the call samples
+ * anew. Histogram splitters are always refined from scratch. The shared
+ * exchange keeps its window here too, created on the first call's comm
+ * and regrown when some rank's data outgrows it; destroying a workspace
+ * that holds one is collective over that comm.
+ */
+template <typename T>
+struct PsrsWorkspace {
+    std::vector<long long> send_counts;
+    std::vector<long long> send_displs;
+    std::vector<long long> recv_counts;
+    std::vector<long long> recv_displs;
+    std::vector<T> recv_buffer;     // Only grows; the exchange uses a prefix
+    std::vector<T> merged;          // Merge output, swapped with the local data
+    std::vector<TaggedPivot<T>> pivots;     // Last sampled pivots
+    std::unique_ptr<SharedWindow<T>> window;   // ExchangeMethod::Shared only
+    double pivot_imbalance;         // Largest output / (n/p) when they were chosen
+    bool reuse_splitters;           // Try the last pivots before sampling
+    bool reused;                    // Whether the last call kept them
+    
+    PsrsWorkspace() : pivot_imbalance(0), reuse_splitters(false), reused(false) {}
+};
+
+// psrs_sort() with caller-owned buffers and splitters
+template <typename T>
+void psrs_sort(std::vector<T>& local_data,
+               int rank,
+               int size,
+               MPI_Comm comm,
+               TimingData& timing,
+               const SortConfig& config,
+               PsrsWorkspace<T>& workspace);
+
+/**
+ * Insert a new batch into an already sorted distributed array
+ *
+ * resident must be globally sorted (each rank's block sorted, blocks in
+ * rank order), e.g. the output of psrs_sort(). Only the batch goes through
+ * the pipeline: it is sorted locally and partitioned at the resident rank
+ * boundaries (the last key of every rank), so no sampling is needed. Each
+ * rank receives one bucket, merges its runs, and merges the bucket into
+ * its resident keys from the back. A key above every resident one goes to
+ * the last rank, and empty ranks receive nothing.
+ *
+ * Batches landing unevenly skew the layout over time. When the fullest
+ * rank holds more than config.rebalance_threshold times the average, the
+ * resident array is moved back to an even n/p split (timing.rebalanced).
+ * If every rank's resident data is empty, the batch is sorted with
+ * psrs_sort() instead. batch is consumed.
+ */
+template <typename T>
+void psrs_insert_batch(std::vector<T>& resident,
+                       std::vector<T>& batch,
+                       int rank,
+                       int size,
+                       MPI_Comm comm,
+                       TimingData& timing,
+                       const SortConfig& config = SortConfig());
 
 // Helper functions
-void select_regular_samples(const std::vector<int>& data,
-                           std::vector<int>& samples,
+template <typename T>
+void select_regular_samples(const std::vector<T>& data,
+                           std::vector<T>& samples,
                            int num_samples);
 
-void partition_by_pivots(const std::vector<int>& data,
-                        const std::vector<int>& pivots,
-                        std::vector<std::vector<int>>& partitions);
+// Split offsets of this rank's sorted data at the pivots (p-1 binary
+// searches, ties broken by (key, rank, index)); the counts/displacements
+// index data directly as the MPI_Alltoallv send buffer
+template <typename T>
+void partition_by_pivots(const std::vector<T>& data,
+                        int rank,
+                        const std::vector<TaggedPivot<T>>& pivots,
+                        std::vector<long long>& send_counts,
+                        std::vector<long long>& send_displs);
+
+// Loser-tree k-way merge of the runs buffer[displs[k], displs[k] + counts[k])
+// into result; a pairwise merge tree is used when there are only a few runs
+template <typename T>
+void merge_partitions(const std::vector<T>& buffer,
+                     const std::vector<long long>& displs,
+                     const std::vector<long long>& counts,
+                     std::vector<T>& result,
+                     ThreadPool& pool);
 
-void merge_partitions(const std::vector<std::vector<int>>& partitions,
-                     std::vector<int>& result);
+// Loser-tree merge on the key runs that moves each winner's payload with it
+template <typename K, typename P>
+void merge_partitions_soa(const std::vector<K>& key_buffer,
+                          const std::vector<P>& payload_buffer,
+                          const std::vector<long long>& displs,
+                          const std::vector<long long>& counts,
+                          std::vector<K>& keys,
+                          std::vector<P>& payloads,
+                          ThreadPool& pool);
 
 #endif // PSRS_SORT_H
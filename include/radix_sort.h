@@ -0,0 +1,61 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sort_types.h"
+
+/**
+ * LSD Radix Sort on the element key (local-sort engine)
+ *
+ * Algorithm:
+ * 1. One pre-pass builds the histograms of every 8-bit key digit
+ * 2. Digits on which every key agrees are skipped
+ * 3. Each remaining pass scatters whole elements through per-bucket
+ *    write-combining buffers of one cache line. A bucket's first flush
+ *    stops at the next 64-byte boundary of the output, so the rest leave
+ *    as whole aligned lines when the element size divides 64
+ *
+ * Keys are mapped to unsigned integers that order the same way: signed
+ * integers flip the sign bit, floating point flips all bits of negative
+ * values and the sign bit of the rest. Payloads move with their keys.
+ * Time: O(n) per pass, 4 passes for 32-bit and 8 for 64-bit keys;
+ * needs n extra elements of buffer
+ */
+template <typename T>
+void radix_sort(std::vector<T>& data);
+
+// Sort data[0, n) using buffer[0, n) as scratch space
+template <typename T>
+void radix_sort(T* data, size_t n, T* buffer);
+
+// Order-preserving map from a key to an unsigned integer
+inline uint32_t radix_key(int key) {
+    return static_cast<uint32_t>(key) ^ 0x80000000u;
+}
+
+inline uint64_t radix_key(std::int64_t key) {
+    return static_cast<uint64_t>(key) ^ 0x8000000000000000ull;
+}
+
+inline uint32_t radix_key(float key) {
+    uint32_t bits;
+    std::memcpy(&bits, &key, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+inline uint64_t radix_key(double key) {
+    uint64_t bits;
+    std::memcpy(&bits, &key, sizeof(bits));
+    return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+}
+
+// The mapped key of an element
+template <typename T>
+inline auto element_radix_key(const T& value) {
+    return radix_key(SortTraits<T>::key(value));
+}
+
+#endif // RADIX_SORT_H
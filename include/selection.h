@@ -0,0 +1,71 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <vector>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Distributed selection: exact k-th elements without sorting the data
+ *
+ * Algorithm:
+ * 1. Every rank starts with all of its elements as candidates; each query
+ *    (a global rank k) brackets its answer between two keys, initially
+ *    unbounded
+ * 2. Every rank takes regular samples of its candidates
+ *    (select_regular_samples); the root gathers them, and for each open
+ *    query picks two samples around where its answer should fall within
+ *    its bracket. The pivots are broadcast, as in PSRS
+ * 3. One pass over the candidates counts the keys below and equal to
+ *    every pivot; MPI_Allreduce sums the counts across ranks
+ * 4. A query is answered once a pivot's run of equal keys covers k;
+ *    otherwise the pivots nearest k on either side become its new bracket
+ * 5. Candidates outside every open bracket are dropped, so each round
+ *    passes over a fraction of the last round's data
+ * 6. Once few candidates remain on all ranks together, they are gathered
+ *    everywhere and sorted, and the remaining queries are read off directly
+ *
+ * A round whose samples miss some open bracket takes four times as many
+ * samples next time, so every query makes progress. The local data is
+ * never reordered. Ties are resolved by the element order, so payloads of
+ * equal keys are arbitrary among the equal elements.
+ *
+ * In timing, local_sort holds the counting and filtering passes, comm the
+ * collectives, and merge the pivot choice and the final sort;
+ * splitter_rounds is the number of narrowing rounds.
+ *
+ * T is any type from FOR_EACH_SORT_TYPE (sort_types.h).
+ */
+
+// Elements of global ranks ranks[i] (0-based, in sorted order over all
+// ranks' data) into result[i], on every rank. Ranks are clamped to
+// [0, n); with no data at all every result is T().
+template <typename T>
+void distributed_select(const std::vector<T>& data,
+                        const std::vector<long long>& ranks,
+                        MPI_Comm comm,
+                        TimingData& timing,
+                        std::vector<T>& result);
+
+// Quantiles by nearest rank: fractions[i] in [0, 1] selects the element
+// of global rank round(fractions[i] * (n - 1)), so 0.5 is the median
+// (the lower one for even n)
+template <typename T>
+void distributed_quantiles(const std::vector<T>& data,
+                           const std::vector<double>& fractions,
+                           MPI_Comm comm,
+                           TimingData& timing,
+                           std::vector<T>& result);
+
+// This rank's share of the k largest elements over all ranks, largest
+// first. Copies of the smallest selected key are taken from the lowest
+// ranks first, so the shares add up to exactly min(k, n).
+template <typename T>
+void distributed_top_k(const std::vector<T>& data,
+                       long long k,
+                       MPI_Comm comm,
+                       TimingData& timing,
+                       std::vector<T>& top);
+
+#endif // SELECTION_H
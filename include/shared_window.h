@@ -0,0 +1,72 @@
+#ifndef SHARED_WINDOW_H
+#define SHARED_WINDOW_H
+
+#include <vector>
+#include <mpi.h>
+#include "sort_types.h"
+
+/**
+ * One block of T per rank in an MPI_Win_allocate_shared window
+ *
+ * Every rank of comm must share memory with every other, i.e.
+ * shared_memory_nodes(comm) == 1 (hierarchical_exchange.h). Each rank
+ * writes its own block with plain stores and reads any peer's block with
+ * plain loads: sync() orders them, so stores made before it on one rank
+ * are visible to loads made after it on all ranks. Construction and
+ * destruction are collective over comm; the destructor does not wait for
+ * peers, so sync() once more before it when peers may still be reading.
+ */
+template <typename T>
+class SharedWindow {
+private:
+    MPI_Win win;
+    MPI_Comm comm;
+    int rank;
+    size_t local_capacity;
+    std::vector<T*> blocks;
+
+public:
+    // Allocate capacity elements for this rank; capacities may differ
+    SharedWindow(size_t capacity, MPI_Comm comm);
+    ~SharedWindow();
+
+    SharedWindow(const SharedWindow&) = delete;
+    SharedWindow& operator=(const SharedWindow&) = delete;
+
+    // Elements this rank's block holds
+    size_t capacity() const { return local_capacity; }
+
+    // This rank's block, and any rank's block for reading
+    T* local() { return blocks[rank]; }
+    const T* block(int r) const { return blocks[r]; }
+
+    // Memory barrier plus MPI_Barrier across comm
+    void sync();
+    
+    // Memory barrier only, for a window synchronized along with another
+    // window's sync()
+    void fence();
+};
+
+/**
+ * MPI_Alltoallv through a SharedWindow: each rank copies its send buffer
+ * into its block once, and every rank copies its runs out of the peers'
+ * blocks. Same layout rules and result as hierarchical_alltoallv; comm
+ * must be a single shared-memory node.
+ *
+ * This saves the transport's copies, not memory: the window block is a
+ * full copy of the send buffer, so peak memory is send buffer, window and
+ * receive buffer. psrs_sort() does better with its own window: the input
+ * is dead once copied in, so the merge writes over it and the peak is the
+ * window plus the output.
+ */
+template <typename T>
+void shared_alltoallv(const T* send_buffer,
+                      const std::vector<long long>& send_counts,
+                      const std::vector<long long>& send_displs,
+                      T* recv_buffer,
+                      const std::vector<long long>& recv_counts,
+                      const std::vector<long long>& recv_displs,
+                      MPI_Comm comm);
+
+#endif // SHARED_WINDOW_H
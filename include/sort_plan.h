@@ -0,0 +1,87 @@
+#ifndef SORT_PLAN_H
+#define SORT_PLAN_H
+
+#include <vector>
+#include <mpi.h>
+#include "utils.h"
+#include "psrs_sort.h"
+#include "bitonic_sort.h"
+#include "distributed_radix_sort.h"
+#include "sort_types.h"
+
+// Distributed sort a SortPlan runs
+enum class SortAlgorithm {
+    Psrs,
+    Bitonic,
+    Radix       // distributed_radix_sort(); keeps no buffers between calls
+};
+
+// What a SortPlan keeps between executions
+struct PlanOptions {
+    bool reuse_splitters;   // PSRS: warm-start from the last pivots (PsrsWorkspace)
+    bool huge_pages;        // Ask for transparent huge pages on the scratch buffers
+    
+    PlanOptions() : reuse_splitters(true), huge_pages(false) {}
+};
+
+/**
+ * Distributed sort planned once and executed many times
+ *
+ * For programs that sort repeatedly inside a larger job. The plan
+ * duplicates comm once, so its messages never match the caller's, and
+ * builds the node grouping that the hierarchical and shared exchanges
+ * cache on the duplicate. It also sizes its scratch buffers for capacity
+ * elements per rank up front. Every execute() reuses the same buffers:
+ * PsrsWorkspace for PSRS and BitonicBuffers for bitonic. Calls that fit
+ * what earlier calls needed therefore allocate no receive or output
+ * buffers. Buffers grow when a call needs more and stay grown. With
+ * options.reuse_splitters, PSRS tries the last call's pivots before
+ * sampling again.
+ *
+ * execute() swaps storage between data and the plan, so the vector passed
+ * in may come back with a different buffer. Construction and destruction
+ * are collective over comm, and a plan must be destroyed before
+ * MPI_Finalize. config.memory_budget is ignored, since plans sort in
+ * memory.
+ *
+ * Instantiated for FOR_EACH_SORT_TYPE (sort_types.h).
+ */
+template <typename T>
+class SortPlan {
+private:
+    MPI_Comm comm;
+    int rank;
+    int size;
+    SortAlgorithm algorithm;
+    SortConfig config;
+    PsrsWorkspace<T> psrs;
+    BitonicBuffers<T> bitonic;
+    int executions;
+    int splitter_reuses;
+    
+public:
+    SortPlan(MPI_Comm comm, size_t capacity,
+             SortAlgorithm algorithm = SortAlgorithm::Psrs,
+             const SortConfig& config = SortConfig(),
+             const PlanOptions& options = PlanOptions());
+    ~SortPlan();
+    
+    SortPlan(const SortPlan&) = delete;
+    SortPlan& operator=(const SortPlan&) = delete;
+    
+    // Sort the distributed data; collective over the plan's communicator.
+    // Any local count works, including more than capacity.
+    void execute(std::vector<T>& data);
+    void execute(std::vector<T>& data, TimingData& timing);
+    
+    // Drop the kept pivots, e.g. once the key distribution has changed
+    void reset_splitters();
+    
+    // Executions so far, and how many of them kept the last pivots
+    int execution_count() const { return executions; }
+    int splitter_reuse_count() const { return splitter_reuses; }
+    
+    MPI_Comm communicator() const { return comm; }
+};
+
+#endif // SORT_PLAN_H
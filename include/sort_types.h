@@ -0,0 +1,96 @@
+#ifndef SORT_TYPES_H
+#define SORT_TYPES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <mpi.h>
+
+/**
+ * Element types supported by the sorters
+ *
+ * Plain keys (int, int64, float, double) sort by value. Key+payload
+ * elements use KeyValue (array-of-structs layout) and sort by key only;
+ * the payload travels with its key through every exchange and merge.
+ * Kernels only use operator<, so any type with a strict weak ordering and
+ * an mpi_type<T>() works.
+ */
+
+// Fixed-size opaque payload carried alongside a key (e.g. a record body)
+template <size_t N>
+struct FixedPayload {
+    unsigned char bytes[N];
+};
+
+// Key with an attached payload, ordered by key only
+template <typename K, typename P>
+struct KeyValue {
+    K key;
+    P value;
+};
+
+template <typename K, typename P>
+inline bool operator<(const KeyValue<K, P>& a, const KeyValue<K, P>& b) {
+    return a.key < b.key;
+}
+
+// Production record shapes: 64-bit key with a row ID, or a 64-byte record
+using RowIdRecord = KeyValue<std::int64_t, std::int64_t>;
+using Record64 = KeyValue<std::int64_t, FixedPayload<56>>;
+
+// Every element type the sorters are instantiated for
+#define FOR_EACH_SORT_TYPE(X) \
+    X(int)                    \
+    X(std::int64_t)           \
+    X(float)                  \
+    X(double)                 \
+    X(RowIdRecord)            \
+    X(Record64)
+
+// Key access per element type
+template <typename T>
+struct SortTraits {
+    using key_type = T;
+    static const key_type& key(const T& value) { return value; }
+    static T make(key_type key) { return key; }
+};
+
+template <typename K, typename P>
+struct SortTraits<KeyValue<K, P>> {
+    using key_type = K;
+    static const key_type& key(const KeyValue<K, P>& value) { return value.key; }
+    static KeyValue<K, P> make(key_type key) {
+        KeyValue<K, P> value;
+        std::memset(&value, 0, sizeof(value));
+        value.key = key;
+        return value;
+    }
+};
+
+/**
+ * MPI datatype for an element type
+ *
+ * Built-in types map to their MPI counterparts. Records are sent as a
+ * committed contiguous block of bytes, created on first use (after
+ * MPI_Init) and kept for the lifetime of the process.
+ */
+template <typename T>
+inline MPI_Datatype mpi_type() {
+    static_assert(std::is_trivially_copyable<T>::value, "elements are sent as raw bytes");
+    static MPI_Datatype type = [] {
+        MPI_Datatype t;
+        MPI_Type_contiguous(static_cast<int>(sizeof(T)), MPI_BYTE, &t);
+        MPI_Type_commit(&t);
+        return t;
+    }();
+    return type;
+}
+
+template <> inline MPI_Datatype mpi_type<int>() { return MPI_INT; }
+template <> inline MPI_Datatype mpi_type<long>() { return MPI_LONG; }
+template <> inline MPI_Datatype mpi_type<long long>() { return MPI_LONG_LONG; }
+template <> inline MPI_Datatype mpi_type<float>() { return MPI_FLOAT; }
+template <> inline MPI_Datatype mpi_type<double>() { return MPI_DOUBLE; }
+
+#endif // SORT_TYPES_H
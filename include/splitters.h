@@ -0,0 +1,37 @@
+#ifndef SPLITTERS_H
+#define SPLITTERS_H
+
+#include <vector>
+#include <mpi.h>
+#include "utils.h"
+#include "sort_types.h"
+
+/**
+ * Histogram splitter refinement (histogram sort)
+ *
+ * Algorithm:
+ * 1. Every rank contributes regular samples of its sorted data as probes
+ * 2. MPI_Allreduce sums, for every probe, the number of keys below it and
+ *    not above it across all ranks (the global histogram)
+ * 3. A splitter is settled once some probe puts its boundary within
+ *    tolerance elements of its target rank
+ * 4. Otherwise the probes bracketing the target narrow its key range, and
+ *    the next round samples only local keys strictly inside that range
+ * 5. Runs of equal keys straddling a boundary are split by count, rank by
+ *    rank (MPI_Exscan), so duplicates never unbalance the output
+ *
+ * targets[i] is the global rank at which partition i+1 starts. On return,
+ * send_counts/send_displs index the sorted data as an MPI_Alltoallv send
+ * buffer; every boundary lands within tolerance of its target.
+ * Returns the number of refinement rounds.
+ */
+template <typename T>
+int histogram_partition(const std::vector<T>& sorted_data,
+                        const std::vector<long long>& targets,
+                        long long tolerance,
+                        MPI_Comm comm,
+                        TimingData& timing,
+                        std::vector<long long>& send_counts,
+                        std::vector<long long>& send_displs);
+
+#endif // SPLITTERS_H
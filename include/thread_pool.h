@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/**
+ * Fixed-size pool of worker threads owned by one MPI rank
+ *
+ * The calling thread takes part in every parallel_for() as worker 0, so a
+ * pool of size 1 runs tasks inline and spawns no threads. Only the calling
+ * thread may issue MPI calls (MPI_THREAD_FUNNELED); workers only compute.
+ */
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+
+    const std::function<void(int)>* current_task;
+    int num_tasks;
+    std::atomic<int> next_task;
+    int active_workers;
+    unsigned long generation;
+    bool stopping;
+
+    void worker_loop();
+    void drain_tasks();
+
+public:
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run task(i) for every i in [0, count) and wait until all have finished
+    void parallel_for(int count, const std::function<void(int)>& task);
+};
+
+// Per-process pool shared by the sorters; recreated if the size changes
+ThreadPool& get_thread_pool(int num_threads);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <mpi.h>
+
+/**
+ * Per-rank timeline tracing exported as Chrome trace JSON
+ *
+ * trace_start() preallocates a ring buffer of events on every rank and
+ * estimates each rank's MPI_Wtime offset from rank 0 by ping-pong with the
+ * smallest round trip; trace_write() estimates it again, so linear clock
+ * drift is removed too. Events come from three sources:
+ * - Timers with a trace name (utils.h): the phases of every sort
+ * - The MPI profiling interface: every collective, point-to-point, wait
+ *   and collective file call the benchmark makes, through PMPI_ wrappers
+ *   (trace_pmpi.cpp, linked into the benchmark only)
+ * - trace_record() calls, e.g. one slice per benchmark run
+ *
+ * Recording is a few stores into a slot claimed with one atomic increment,
+ * so worker threads may record too. When the buffer is full the oldest
+ * events are overwritten. trace_write() collects every rank's events at
+ * rank 0 into one file that chrome://tracing or ui.perfetto.dev opens,
+ * with one process per rank and one thread row per recording thread.
+ */
+
+// Allocate capacity events per rank and align the clocks. Collective.
+void trace_start(size_t capacity, MPI_Comm comm);
+
+// True between trace_start() and trace_write()
+bool trace_enabled();
+
+// Record a slice [begin, end] of this rank's MPI_Wtime clock. name and
+// category must outlive the trace (string literals). arg >= 0 is shown as
+// the slice's argument (run index, peer rank).
+void trace_record(const char* name, const char* category, double begin, double end,
+                  long long arg = -1);
+
+// Stop recording and write every rank's events to path from rank 0.
+// Collective; returns false on rank 0 if the file cannot be written.
+// recorded/dropped, if given, receive the totals over all ranks on rank 0.
+bool trace_write(const std::string& path, MPI_Comm comm,
+                 long long* recorded = nullptr, long long* dropped = nullptr);
+
+#endif // TRACE_H
@@ -3,7 +3,20 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <mpi.h>
+#include "perf_counters.h"
+#include "memory_usage.h"
+#include "trace.h"
+
+// What a phase Timer accumulates besides its seconds
+struct PhaseCounts {
+    PerfCounts perf;            // Hardware counter deltas (--perf)
+    size_t allocated_bytes;     // Heap bytes allocated during the phase
+    size_t peak_heap_bytes;     // Most heap bytes live at once, input included
+    
+    PhaseCounts() : allocated_bytes(0), peak_heap_bytes(0) {}
+};
 
 // Timing structure to hold different timing components
 struct TimingData {
@@ -12,59 +25,248 @@ struct TimingData {
     double comm_time;
     double merge_time;
     double other_time;
+    double overlap_time;    // Merge time spent while messages were in flight
+    size_t padding_elements;    // Bitonic: virtual +inf keys topping up this block
+    int idle_steps;             // Bitonic: network steps paired with a virtual rank
+    size_t bytes_exchanged;     // Element bytes sent to other ranks
+    int splitter_rounds;        // PSRS: histogram refinement rounds
+    int splitters_reused;       // PSRS: 1 if a plan kept the last call's pivots
+    int rebalanced;             // Incremental: 1 if the batch triggered a rebalance
+    size_t output_elements;     // Elements this rank holds after the sort
+    double io_time;             // External sort: time in spill-file reads/writes
+    size_t spill_bytes;         // External sort: bytes written to spill files
+    double read_time;           // MPI-IO read of the input file
+    double write_time;          // MPI-IO write of the sorted output
+    PhaseCounts local_sort_counts;  // Counters and heap use per phase
+    PhaseCounts comm_counts;
+    PhaseCounts merge_counts;
+    PhaseCounts total_counts;       // The whole sort call
+    size_t peak_rss_bytes;      // Resident set high-water mark over the run
     
     TimingData() : total_time(0), local_sort_time(0), comm_time(0), 
-                   merge_time(0), other_time(0) {}
+                   merge_time(0), other_time(0), overlap_time(0),
+                   padding_elements(0), idle_steps(0), bytes_exchanged(0),
+                   splitter_rounds(0), splitters_reused(0), rebalanced(0), output_elements(0),
+                   io_time(0),
+                   spill_bytes(0), read_time(0), write_time(0), peak_rss_bytes(0) {}
+};
+
+// Shape of the generated input
+enum class InputDistribution {
+    Random,         // Uniform keys (generate_random_data)
+    Zipf,           // Zipf(1.0) over 2^20 values: one hot key, long tail
+    Gaussian,       // Normal around the middle of [0, 1e9]
+    AllEqual,       // Every key identical
+    Sorted,         // Globally ascending
+    ReverseSorted,  // Globally descending
+    NearlySorted,   // Ascending with 1% of each block swapped in random pairs
+    Staggered       // Each rank's keys confined to one block of [0, 1e9],
+                    // blocks permuted across ranks
 };
 
 // Configuration structure
 struct BenchmarkConfig {
     std::string algorithm;
     size_t total_size;
-    int iterations;
+    int iterations;             // Timed runs, one CSV row each
+    int warmup_iterations;      // Untimed runs before the first timed one
     bool verify;
     std::string output_file;
-    unsigned int seed;
+    unsigned int seed;          // Base seed; every run regenerates from its own
+    InputDistribution distribution;
+    std::string input_file;     // Raw binary elements to sort instead of generated data
+    std::string sorted_output_file; // Where the sorted elements are written, if set
+    std::string key_type;       // int, int64, float or double
+    std::string payload;        // none, rowid or record64
+    std::string layout;         // aos or soa
+    bool perf_counters;         // Hardware counters per phase (perf_counters.h)
+    std::string trace_file;     // Chrome trace JSON of every rank's timeline, if set
+    size_t trace_events;        // Trace ring buffer capacity per rank
+    bool use_plan;              // Run every iteration through one SortPlan (sort_plan.h)
+    bool huge_pages;            // Plan scratch buffers on transparent huge pages
+    size_t incremental_batch;   // Insert a batch of this many elements per run, 0 = off
+    std::vector<double> quantiles;  // Select: fractions of n to select (selection.h)
+    long long top_k;            // Select: k largest elements instead, 0 = quantiles
+    bool auto_tune;             // Algorithm "auto": pick it and its parameters (autotune.h)
+    std::string tune_cache;     // Auto: directory of cached probes, empty = none
+    bool retune;                // Auto: probe again even if a cached probe exists
     
     BenchmarkConfig() : algorithm("psrs"), total_size(1000000), 
-                       iterations(5), verify(false), 
-                       output_file(""), seed(42) {}
+                       iterations(1), warmup_iterations(0), verify(true),
+                       output_file(""), seed(42),
+                       distribution(InputDistribution::Random),
+                       key_type("int"), payload("none"), layout("aos"), perf_counters(false),
+                       trace_events(size_t(1) << 20), use_plan(false), huge_pages(false),
+                       incremental_batch(0), top_k(0), auto_tune(false), retune(false) {}
+};
+
+// Kernel used for the local sort step of every algorithm
+enum class LocalSortEngine {
+    StdSort,    // std::sort (introsort)
+    Radix       // LSD radix sort on the key bits (radix_sort.h)
+};
+
+// How PSRS chooses the p-1 splitters
+enum class SplitterMethod {
+    Regular,        // Regular samples per rank, pivots picked at the root
+    Histogram,      // Iterative refinement against global counts (splitters.h)
+    Distributed     // Regular samples sorted across ranks by a bitonic network
 };
 
-// Data generation
-void generate_random_data(std::vector<int>& data, unsigned int seed, int rank);
-void generate_uniform_data(std::vector<int>& data, int rank);
+// How PSRS moves the partitions between ranks
+enum class ExchangeMethod {
+    Flat,           // One MPI_Alltoallv over all ranks
+    Hierarchical,   // Node leaders aggregate, exchange and scatter (hierarchical_exchange.h)
+    Shared          // Single node: peers read each other's blocks in a
+                    // shared-memory window (shared_window.h); bitonic too
+};
+
+// Per-call tuning knobs passed to the sorters
+struct SortConfig {
+    int threads_per_rank;   // Hybrid MPI+threads: worker threads per rank
+    LocalSortEngine local_sort;
+    size_t pipeline_chunk;  // Bitonic: elements per pipelined chunk, 0 = blocking
+    SplitterMethod splitters;
+    int oversampling;       // Regular/distributed: samples per rank = oversampling * p
+    double balance_tolerance;   // Histogram: allowed output deviation, fraction of n/p
+    bool exact_rebalance;   // PSRS: move output so each rank keeps its input count
+    size_t memory_budget;   // External sort: bytes of memory per rank, 0 = in-memory
+    std::string spill_dir;  // External sort: directory for run files
+    ExchangeMethod exchange;    // PSRS: all-to-all algorithm
+    bool low_memory;        // PSRS: free the input after the exchange and merge in place
+    double rebalance_threshold; // Incremental: rebalance past this max/avg resident size
+    
+    SortConfig() : threads_per_rank(1), local_sort(LocalSortEngine::StdSort),
+                   pipeline_chunk(0), splitters(SplitterMethod::Regular), oversampling(1),
+                   balance_tolerance(0.01), exact_rebalance(false),
+                   memory_budget(0), spill_dir("/tmp"),
+                   exchange(ExchangeMethod::Flat), low_memory(false),
+                   rebalance_threshold(1.25) {}
+};
+
+// Name <-> enum mapping for the command line and CSV output
+bool parse_local_sort_engine(const std::string& name, LocalSortEngine& engine);
+const char* local_sort_engine_name(LocalSortEngine engine);
+bool parse_input_distribution(const std::string& name, InputDistribution& distribution);
+const char* input_distribution_name(InputDistribution distribution);
+bool parse_splitter_method(const std::string& name, SplitterMethod& method);
+const char* splitter_method_name(SplitterMethod method);
+bool parse_exchange_method(const std::string& name, ExchangeMethod& method);
+const char* exchange_method_name(ExchangeMethod method);
+
+// Byte count with an optional K, M or G suffix (powers of 1024)
+bool parse_byte_size(const std::string& text, size_t& bytes);
+
+// Comma-separated fractions in [0, 1], e.g. "0.5,0.9,0.99"
+bool parse_fraction_list(const std::string& text, std::vector<double>& fractions);
+
+// Data generation, instantiated for FOR_EACH_SORT_TYPE (sort_types.h).
+// int keys are uniform in [0, 1e9]; int64 keys span the full signed range;
+// floating-point keys are uniform in [-1e9, 1e9]. Records get their global
+// row ID (rank << 40 | index) as payload.
+// first_index is the position of data[0] in the rank's block when the
+// input is generated in chunks.
+template <typename T>
+void generate_random_data(std::vector<T>& data, unsigned int seed, int rank,
+                          size_t first_index = 0);
+template <typename T>
+void generate_uniform_data(std::vector<T>& data, int rank);
+
+// Input of the given shape; collective over comm, since sorted inputs need
+// each rank's global offset
+template <typename T>
+void generate_data(std::vector<T>& data, InputDistribution distribution,
+                   unsigned int seed, MPI_Comm comm);
+
+// Row-ID payloads for struct-of-arrays key+payload data
+template <typename P>
+void generate_payloads(std::vector<P>& payloads, int rank);
 
 // Verification
-bool verify_sorted(const std::vector<int>& data, int rank, int size, MPI_Comm comm);
-bool is_locally_sorted(const std::vector<int>& data);
+template <typename T>
+bool verify_sorted(const std::vector<T>& data, int rank, int size, MPI_Comm comm);
+// Cross-rank half of verify_sorted for data checked elsewhere: combines
+// every rank's local_ok and checks first against the last element of the
+// nearest non-empty lower rank (has_data false for an empty rank).
+// Collective over comm.
+template <typename T>
+bool verify_rank_boundaries(bool local_ok, bool has_data, const T& first, const T& last,
+                            int rank, int size, MPI_Comm comm);
+template <typename T>
+bool is_locally_sorted(const std::vector<T>& data);
+
+// Combine every rank's timing of one run at rank 0 the way it is reported:
+// total, read and write time are the slowest rank's; phase and spill I/O
+// times are rank averages; padding, bytes and spill bytes are sums;
+// idle steps, splitter rounds, splitter reuse and output elements are
+// maxima; hardware counters and allocated bytes are sums; peak heap and
+// RSS are maxima.
+// Collective over comm; the result is only meaningful on rank 0.
+TimingData reduce_timing(const TimingData& timing, MPI_Comm comm);
 
-// Output
+// Output: append one row per timed run, from reduce_timing's result
 void write_results_csv(const std::string& filename, const BenchmarkConfig& config,
-                       const TimingData& timing, int rank, int size, int iteration);
+                       const SortConfig& sort_config, const TimingData& summary,
+                       int rank, int size, int iteration, bool verified);
 
 // Utilities
-void print_statistics(const TimingData& timing, int rank, int size, MPI_Comm comm);
+// Mean, stddev, min, median and p95 of the phase times across the timed
+// runs (slowest rank for total, rank average for phases) and across ranks
+// (each rank's mean over the runs). Collective over comm.
+void print_statistics(const std::vector<TimingData>& runs, int rank, int size, MPI_Comm comm);
 std::string get_timestamp();
 
 // Timer class for easy timing
+// With a PhaseCounts, each start()/stop() interval also adds the bytes it
+// allocated and raises the peak heap seen (memory_usage.h), plus its
+// counter deltas when hardware counters are open (perf_counters.h); with a
+// trace name and tracing on (trace.h), it is also recorded as a phase
+// slice. Timers with counts must nest, never interleave.
 class Timer {
 private:
     double start_time;
     bool running;
+    PhaseCounts* counts;
+    PerfCounts start_counts;
+    size_t start_allocated;
+    size_t enclosing_peak;
+    const char* trace_name;
     
 public:
-    Timer() : start_time(0), running(false) {}
+    explicit Timer(PhaseCounts* counts = nullptr, const char* trace_name = nullptr)
+        : start_time(0), running(false), counts(counts), start_allocated(0),
+          enclosing_peak(0), trace_name(trace_name) {}
     
     void start() {
+        if (counts) {
+            if (perf_counters_enabled()) {
+                start_counts = perf_counters_read();
+            }
+            start_allocated = heap_allocated_bytes();
+            enclosing_peak = heap_begin_interval();
+        }
         start_time = MPI_Wtime();
         running = true;
     }
     
     double stop() {
         if (!running) return 0.0;
-        double elapsed = MPI_Wtime() - start_time;
+        double end_time = MPI_Wtime();
+        double elapsed = end_time - start_time;
         running = false;
+        if (trace_name && trace_enabled()) {
+            trace_record(trace_name, "phase", start_time, end_time);
+        }
+        if (counts) {
+            if (perf_counters_enabled()) {
+                PerfCounts delta = perf_counters_read();
+                delta -= start_counts;
+                counts->perf += delta;
+            }
+            counts->allocated_bytes += heap_allocated_bytes() - start_allocated;
+            counts->peak_heap_bytes = std::max(counts->peak_heap_bytes,
+                                               heap_end_interval(enclosing_peak));
+        }
         return elapsed;
     }
     
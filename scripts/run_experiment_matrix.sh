@@ -21,8 +21,9 @@ mkdir -p "$RESULTS_DIR"
 # Experiment Parameters
 ALGORITHMS=("psrs" "bitonic")
 RANKS=(2 4 8 16)  # Limited due to memory constraints (3.7GB)
-PROBLEM_SIZES=(10000000 100000000)  # 10M, 100M (500M exceeds available memory)
+PROBLEM_SIZES=(10000000 100000000)  # 10M, 100M (500M exceeds available memory in-core; see --external)
 RUNS_PER_POINT=5
+WARMUP_RUNS=1
 
 echo "=============================================="
 echo "  Minimal Experiment Matrix - Concrete"
@@ -41,7 +42,7 @@ echo "Experiment Parameters:"
 echo "  Algorithms:   PSRS, Bitonic"
 echo "  Problem sizes: 10M, 100M keys"
 echo "  Ranks:        2, 4, 8, 16"
-echo "  Runs/point:   $RUNS_PER_POINT"
+echo "  Runs/point:   $RUNS_PER_POINT (+ $WARMUP_RUNS warmup, one launch)"
 echo ""
 echo "=============================================="
 echo ""
@@ -75,22 +76,22 @@ for algo in "${ALGORITHMS[@]}"; do
             
             echo -n "  Ranks $ranks: "
             
-            # Run multiple iterations
-            for run in $(seq 1 $RUNS_PER_POINT); do
-                CURRENT_EXPERIMENT=$((CURRENT_EXPERIMENT + 1))
-                echo -n "[$run]"
-                
-                mpirun --oversubscribe -np $ranks "$BENCHMARK_BIN" \
-                    "$algo" \
-                    "$size" \
-                    "$OUTPUT_FILE" \
-                    > /dev/null 2>&1
-                
-                if [ $? -ne 0 ]; then
-                    echo " FAILED"
-                    exit 1
-                fi
-            done
+            # All runs of a point in one launch: one CSV row per timed run
+            CURRENT_EXPERIMENT=$((CURRENT_EXPERIMENT + RUNS_PER_POINT))
+            echo -n "[$RUNS_PER_POINT runs]"
+            
+            mpirun --oversubscribe -np $ranks "$BENCHMARK_BIN" \
+                "$algo" \
+                "$size" \
+                "$OUTPUT_FILE" \
+                --warmup $WARMUP_RUNS \
+                --iterations $RUNS_PER_POINT \
+                > /dev/null 2>&1
+            
+            if [ $? -ne 0 ]; then
+                echo " FAILED"
+                exit 1
+            fi
             
             # Calculate statistics from CSV
             if [ -f "$OUTPUT_FILE" ]; then
@@ -177,7 +178,7 @@ for algo in "${ALGORITHMS[@]}"; do
                         sum_comm = 0
                         sum_merge = 0
                     }
-                    NF == 6 && $1 ~ /^[0-9]+$/ {
+                    NF >= 6 && $1 ~ /^[0-9]+$/ {
                         total[count] = $3
                         local_sort[count] = $4
                         comm[count] = $5
@@ -0,0 +1,354 @@
+#include "autotune.h"
+#include "parallel_kernels.h"
+#include "hierarchical_exchange.h"
+#include "bitonic_sort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Bytes per rank of the probe's sort and merge blocks
+constexpr size_t PROBE_BYTES = size_t(4) << 20;
+
+// Ping-pong message sizes and round trips
+constexpr size_t LARGE_MESSAGE = size_t(1) << 20;
+constexpr int SMALL_ROUND_TRIPS = 200;
+constexpr int LARGE_ROUND_TRIPS = 10;
+
+// Values of a MachineProfile as stored in the cache and broadcast
+constexpr int PROFILE_FIELDS = 6;
+
+// Candidate oversampling factors and pipeline chunks (elements)
+const int OVERSAMPLING_CHOICES[] = {1, 2, 4, 8, 16, 32, 64};
+constexpr int MIN_CHUNK_SHIFT = 12;
+constexpr int MAX_CHUNK_SHIFT = 22;
+
+// Cache key of an element type and local sort engine, e.g. "i32-std"
+template <typename T>
+std::string type_tag(LocalSortEngine engine) {
+    const char* kind = std::is_floating_point<T>::value ? "f"
+                     : std::is_integral<T>::value ? "i" : "r";
+    return kind + std::to_string(sizeof(T) * 8) + "-" + local_sort_engine_name(engine);
+}
+
+void profile_to_array(const MachineProfile& profile, double* values) {
+    values[0] = profile.latency;
+    values[1] = profile.byte_time;
+    values[2] = profile.sort_time;
+    values[3] = profile.merge_time;
+    values[4] = profile.cores_per_rank;
+    values[5] = profile.thread_speedup;
+}
+
+MachineProfile profile_from_array(const double* values) {
+    MachineProfile profile;
+    profile.latency = values[0];
+    profile.byte_time = values[1];
+    profile.sort_time = values[2];
+    profile.merge_time = values[3];
+    profile.cores_per_rank = static_cast<int>(values[4]);
+    profile.thread_speedup = values[5];
+    return profile;
+}
+
+// Average round-trip time of messages of the given size with partner
+double ping_pong(int partner, bool initiator, size_t bytes, int round_trips,
+                 std::vector<char>& buffer, MPI_Comm comm) {
+    buffer.resize(std::max<size_t>(bytes, 1));
+    int count = static_cast<int>(bytes);
+    double start = MPI_Wtime();
+    for (int i = 0; i < round_trips; ++i) {
+        if (initiator) {
+            MPI_Send(buffer.data(), count, MPI_BYTE, partner, 0, comm);
+            MPI_Recv(buffer.data(), count, MPI_BYTE, partner, 0, comm, MPI_STATUS_IGNORE);
+        } else {
+            MPI_Recv(buffer.data(), count, MPI_BYTE, partner, 0, comm, MPI_STATUS_IGNORE);
+            MPI_Send(buffer.data(), count, MPI_BYTE, partner, 0, comm);
+        }
+    }
+    return (MPI_Wtime() - start) / round_trips;
+}
+
+// Seconds to sort a fresh random block with a pool of the given size
+template <typename T>
+double time_sort(size_t elements, int threads, LocalSortEngine engine, int rank) {
+    std::vector<T> data(elements);
+    generate_random_data(data, 7919u + threads, rank);
+    ThreadPool& pool = get_thread_pool(threads);
+    double start = MPI_Wtime();
+    parallel_sort(data, pool, engine);
+    return MPI_Wtime() - start;
+}
+
+// $dir and every missing parent
+void make_directories(const std::string& dir) {
+    for (size_t slash = dir.find('/', 1); ; slash = dir.find('/', slash + 1)) {
+        ::mkdir(dir.substr(0, slash).c_str(), 0755);
+        if (slash == std::string::npos) break;
+    }
+}
+
+// <cache_dir>/<host>_n<nodes>_p<ranks>.tune; the host is rank 0's
+std::string cache_path(const std::string& cache_dir, int nodes, int size) {
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    return cache_dir + "/" + host + "_n" + std::to_string(nodes)
+         + "_p" + std::to_string(size) + ".tune";
+}
+
+bool read_cached_profile(const std::string& path, const std::string& tag, double* values) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key != tag) continue;
+        for (int i = 0; i < PROFILE_FIELDS; ++i) {
+            if (!(fields >> values[i])) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Replace the tag's line, keeping the other element types' probes
+void write_cached_profile(const std::string& path, const std::string& tag, const double* values) {
+    std::vector<std::string> lines;
+    std::ifstream existing(path);
+    std::string line;
+    while (std::getline(existing, line)) {
+        if (line.compare(0, tag.size() + 1, tag + " ") != 0) lines.push_back(line);
+    }
+    existing.close();
+    std::ostringstream entry;
+    entry.precision(9);
+    entry << tag;
+    for (int i = 0; i < PROFILE_FIELDS; ++i) entry << " " << values[i];
+    lines.push_back(entry.str());
+
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    std::ofstream file(temp);
+    for (const std::string& l : lines) file << l << "\n";
+    file.close();
+    if (!file || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+    }
+}
+
+double log2_of(double x) {
+    return x > 1 ? std::log2(x) : 0.0;
+}
+
+} // namespace
+
+template <typename T>
+MachineProfile probe_machine(MPI_Comm comm, LocalSortEngine engine) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MachineProfile profile;
+
+    // Ping-pong between ranks r and r + p/2, every pair at once
+    double local[PROFILE_FIELDS] = {0, 0, 0, 0, 0, 0};
+    int half = size / 2;
+    if (half > 0 && rank < 2 * half) {
+        int partner = rank < half ? rank + half : rank - half;
+        bool initiator = rank < half;
+        std::vector<char> buffer;
+        ping_pong(partner, initiator, 8, 10, buffer, comm);
+        double small = ping_pong(partner, initiator, 8, SMALL_ROUND_TRIPS, buffer, comm);
+        double large = ping_pong(partner, initiator, LARGE_MESSAGE, LARGE_ROUND_TRIPS, buffer, comm);
+        local[0] = small / 2;
+        local[1] = std::max(0.0, (large / 2 - local[0]) / LARGE_MESSAGE);
+    }
+
+    // Local sort and merge throughput, one thread
+    size_t elements = std::max<size_t>(4096, PROBE_BYTES / sizeof(T));
+    double sort_seconds = time_sort<T>(elements, 1, engine, rank);
+    local[2] = sort_seconds / (elements * log2_of(elements));
+
+    std::vector<T> a(elements / 2);
+    std::vector<T> b(elements - a.size());
+    std::vector<T> merged(elements);
+    generate_random_data(a, 104729u, rank);
+    generate_random_data(b, 1299709u, rank);
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    double start = MPI_Wtime();
+    std::merge(a.begin(), a.end(), b.begin(), b.end(), merged.begin());
+    local[3] = (MPI_Wtime() - start) / elements;
+
+    // The cores this rank's share of the node allows, and what they give
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+    int node_size;
+    MPI_Comm_size(node_comm, &node_size);
+    MPI_Comm_free(&node_comm);
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    int cores = std::max(1, hardware / node_size);
+    MPI_Allreduce(MPI_IN_PLACE, &cores, 1, MPI_INT, MPI_MIN, comm);
+    profile.cores_per_rank = cores;
+    if (cores > 1) {
+        double threaded = time_sort<T>(elements, cores, engine, rank);
+        local[5] = threaded > 0 ? sort_seconds / threaded : 1.0;
+    } else {
+        local[5] = 1.0;
+    }
+
+    // Slowest rank; the smallest speedup
+    double global[PROFILE_FIELDS];
+    MPI_Allreduce(local, global, 4, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(&local[5], &global[5], 1, MPI_DOUBLE, MPI_MIN, comm);
+    profile.latency = global[0];
+    profile.byte_time = global[1];
+    profile.sort_time = global[2];
+    profile.merge_time = global[3];
+    profile.thread_speedup = global[5];
+    return profile;
+}
+
+TuningDecision choose_parameters(const MachineProfile& profile, long long n,
+                                 size_t element_bytes, int size,
+                                 const TuningOptions& options) {
+    TuningDecision decision;
+    decision.profile = profile;
+    double p = size;
+    double m = std::ceil(static_cast<double>(n) / size);
+    double alpha = profile.latency;
+    double block_bytes = m * element_bytes * profile.byte_time;
+    int levels = ceil_log2(size);
+
+    double best = -1;
+    for (int threads : {1, profile.cores_per_rank}) {
+        double speedup = threads == 1 ? 1.0 : profile.thread_speedup;
+        if (threads > 1 && speedup <= 1.0) continue;
+        double local_sort = profile.sort_time * m * log2_of(m) / speedup;
+        double merge_time = profile.merge_time / speedup;
+
+        // PSRS: more samples cost a bigger gather and root sort, fewer a
+        // larger worst-case output
+        for (int k : OVERSAMPLING_CHOICES) {
+            if (k > 1 && k * p > m) break;
+            double samples = k * p * p;
+            double f = size > 1 ? 1.0 + 1.0 / k : 1.0;
+            double estimate = local_sort;
+            if (size > 1) {
+                estimate += 2 * levels * alpha + samples * element_bytes * profile.byte_time
+                          + profile.sort_time * samples * log2_of(samples)
+                          + (p - 1) * alpha + f * block_bytes * (p - 1) / p
+                          + merge_time * f * m * log2_of(p);
+            }
+            if (decision.psrs_estimate == 0 || estimate < decision.psrs_estimate) {
+                decision.psrs_estimate = estimate;
+            }
+            if (best < 0 || estimate < best) {
+                best = estimate;
+                decision.algorithm = SortAlgorithm::Psrs;
+                decision.oversampling = k;
+                decision.pipeline_chunk = 0;
+                decision.threads_per_rank = threads;
+            }
+        }
+
+        // Bitonic: every step moves and merges the whole block; chunks
+        // overlap the two at one latency each
+        if (!options.allow_bitonic) continue;
+        double steps = levels * (levels + 1) / 2.0;
+        double merge = merge_time * m;
+        std::vector<size_t> chunks(1, 0);
+        for (int shift = MIN_CHUNK_SHIFT; options.allow_pipeline && shift <= MAX_CHUNK_SHIFT; ++shift) {
+            if ((size_t(1) << shift) >= m) break;
+            chunks.push_back(size_t(1) << shift);
+        }
+        for (size_t chunk : chunks) {
+            double step = alpha + block_bytes + merge;
+            if (chunk > 0) {
+                double pieces = std::ceil(m / chunk);
+                double exchange = pieces * alpha + block_bytes;
+                step = std::max(exchange, merge) + std::min(exchange, merge) / pieces;
+            }
+            double estimate = local_sort + steps * step;
+            if (decision.bitonic_estimate == 0 || estimate < decision.bitonic_estimate) {
+                decision.bitonic_estimate = estimate;
+            }
+            if (estimate < best) {
+                best = estimate;
+                decision.algorithm = SortAlgorithm::Bitonic;
+                decision.oversampling = 1;
+                decision.pipeline_chunk = chunk;
+                decision.threads_per_rank = threads;
+            }
+        }
+    }
+    return decision;
+}
+
+template <typename T>
+TuningDecision autotune(long long n, MPI_Comm comm, LocalSortEngine engine,
+                        const TuningOptions& options) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    std::string tag = type_tag<T>(engine);
+    std::string path;
+    if (!options.cache_dir.empty()) {
+        path = cache_path(options.cache_dir, shared_memory_nodes(comm), size);
+    }
+
+    // Rank 0 looks the probe up and shares it
+    double values[PROFILE_FIELDS + 1] = {0, 0, 0, 0, 0, 0, 0};
+    if (rank == 0 && !path.empty() && !options.reprobe) {
+        values[PROFILE_FIELDS] = read_cached_profile(path, tag, values) ? 1 : 0;
+    }
+    MPI_Bcast(values, PROFILE_FIELDS + 1, MPI_DOUBLE, 0, comm);
+    bool cached = values[PROFILE_FIELDS] == 1;
+
+    MachineProfile profile;
+    double probe_time = 0;
+    if (cached) {
+        profile = profile_from_array(values);
+    } else {
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+        profile = probe_machine<T>(comm, engine);
+        probe_time = MPI_Wtime() - start;
+        if (rank == 0 && !path.empty()) {
+            make_directories(options.cache_dir);
+            profile_to_array(profile, values);
+            write_cached_profile(path, tag, values);
+        }
+    }
+
+    TuningDecision decision = choose_parameters(profile, n, sizeof(T), size, options);
+    decision.from_cache = cached;
+    decision.probe_time = probe_time;
+    return decision;
+}
+
+void apply_decision(const TuningDecision& decision, SortConfig& config) {
+    config.oversampling = decision.oversampling;
+    config.pipeline_chunk = decision.pipeline_chunk;
+    config.threads_per_rank = decision.threads_per_rank;
+}
+
+std::string default_tuning_cache_dir() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) return std::string(xdg) + "/parallel_sort";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::string(home) + "/.cache/parallel_sort";
+    return "";
+}
+
+#define INSTANTIATE_AUTOTUNE(T) \
+    template MachineProfile probe_machine<T>(MPI_Comm, LocalSortEngine); \
+    template TuningDecision autotune<T>(long long, MPI_Comm, LocalSortEngine, const TuningOptions&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_AUTOTUNE)
@@ -1,145 +1,482 @@
 #include "bitonic_sort.h"
+#include "parallel_kernels.h"
+#include "shared_window.h"
+#include "large_count.h"
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <cstring>
 
 bool is_power_of_two(int n) {
     return n > 0 && (n & (n - 1)) == 0;
 }
 
-void merge_low(std::vector<int>& data, const std::vector<int>& received) {
-    // Keep the smaller half after merging
-    std::vector<int> merged;
-    merged.reserve(data.size() + received.size());
+template <typename T>
+void merge_low(std::vector<T>& data, const std::vector<T>& received, size_t keep,
+               std::vector<T>& scratch, ThreadPool& pool) {
+    size_t n = data.size();
+    size_t m = received.size();
+    scratch.resize(keep);
     
+    if (pool.size() > 1) {
+        // Merge-path split: each thread writes its share of the lower ranks
+        parallel_merge_range(data.data(), n, received.data(), m,
+                             0, keep, scratch.data(), pool);
+        data.swap(scratch);
+        return;
+    }
+    
+    // Walk from the front and stop once the smaller half is complete
     size_t i = 0, j = 0;
-    while (i < data.size() && j < received.size()) {
-        if (data[i] <= received[j]) {
-            merged.push_back(data[i++]);
+    for (size_t k = 0; k < keep; ++k) {
+        if (j >= m || (i < n && !(received[j] < data[i]))) {
+            scratch[k] = data[i++];
         } else {
-            merged.push_back(received[j++]);
+            scratch[k] = received[j++];
         }
     }
-    while (i < data.size()) {
-        merged.push_back(data[i++]);
-    }
-    while (j < received.size()) {
-        merged.push_back(received[j++]);
+    data.swap(scratch);
+}
+
+template <typename T>
+void merge_high(std::vector<T>& data, const std::vector<T>& received, size_t keep,
+                std::vector<T>& scratch, ThreadPool& pool) {
+    size_t n = data.size();
+    size_t m = received.size();
+    scratch.resize(keep);
+    
+    if (pool.size() > 1) {
+        // Merge-path split: each thread writes its share of the upper ranks.
+        // The partner's (lower) keys go first so ties split as on the low side.
+        parallel_merge_range(received.data(), m, data.data(), n,
+                             n + m - keep, keep, scratch.data(), pool);
+        data.swap(scratch);
+        return;
     }
     
-    // Keep only the first half
-    data.assign(merged.begin(), merged.begin() + data.size());
+    // Walk from the back and stop once the larger half is complete; equal
+    // keys rank the partner's (lower) copy first, as merge_low does
+    size_t i = n, j = m;
+    for (size_t k = keep; k > 0; --k) {
+        if (j == 0 || (i > 0 && !(data[i - 1] < received[j - 1]))) {
+            scratch[k - 1] = data[--i];
+        } else {
+            scratch[k - 1] = received[--j];
+        }
+    }
+    data.swap(scratch);
 }
 
-void merge_high(std::vector<int>& data, const std::vector<int>& received) {
-    // Keep the larger half after merging
-    std::vector<int> merged;
-    merged.reserve(data.size() + received.size());
+namespace {
+
+// Element count plus the boundary element the partner needs
+template <typename T>
+struct ExchangeHeader {
+    long long count;
+    T boundary;
+};
+
+// Chunk c of an n-element block when sent front-to-back or back-to-front
+inline void chunk_bounds(size_t n, size_t chunk, size_t c, bool from_back,
+                         size_t& first, size_t& last) {
+    if (from_back) {
+        last = n - std::min(n, c * chunk);
+        first = last - std::min(last, chunk);
+    } else {
+        first = std::min(n, c * chunk);
+        last = std::min(n, first + chunk);
+    }
+}
+
+/**
+ * Chunked exchange that merges chunk k while chunk k+1 is in flight
+ *
+ * The low side needs the partner's smallest keys first and the high side
+ * its largest, so each rank sends its block in the order the partner
+ * consumes it: the low side back-to-front, the high side front-to-back.
+ * The kept part is produced incrementally as chunks arrive.
+ */
+template <typename T>
+void pipelined_exchange_merge(std::vector<T>& local_data,
+                              size_t partner_size,
+                              size_t keep,
+                              int partner_rank,
+                              bool keep_small,
+                              MPI_Comm comm,
+                              size_t chunk,
+                              TimingData& timing,
+                              BitonicBuffers<T>& buffers) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    MPI_Datatype type = mpi_type<T>();
     
-    size_t i = 0, j = 0;
-    while (i < data.size() && j < received.size()) {
-        if (data[i] <= received[j]) {
-            merged.push_back(data[i++]);
+    size_t n = local_data.size();
+    size_t m = partner_size;
+    size_t send_chunks = (n + chunk - 1) / chunk;
+    size_t recv_chunks = (m + chunk - 1) / chunk;
+    
+    buffers.partner.resize(m);
+    buffers.kept.resize(keep);
+    const T* data = local_data.data();
+    const T* partner = buffers.partner.data();
+    T* out = buffers.kept.data();
+    
+    // Post every chunk up front; one tag suffices since MPI keeps order
+    comm_timer.start();
+    std::vector<MPI_Request> send_requests(send_chunks);
+    std::vector<MPI_Request> recv_requests(recv_chunks);
+    for (size_t c = 0; c < recv_chunks; ++c) {
+        size_t first, last;
+        chunk_bounds(m, chunk, c, !keep_small, first, last);
+        MPI_Irecv(buffers.partner.data() + first, static_cast<int>(last - first), type,
+                  partner_rank, 1, comm, &recv_requests[c]);
+    }
+    for (size_t c = 0; c < send_chunks; ++c) {
+        size_t first, last;
+        chunk_bounds(n, chunk, c, keep_small, first, last);
+        MPI_Isend(local_data.data() + first, static_cast<int>(last - first), type,
+                  partner_rank, 1, comm, &send_requests[c]);
+    }
+    timing.comm_time += comm_timer.stop();
+    
+    // Merge cursors: the low side walks forward, the high side backward
+    size_t i = keep_small ? 0 : n;
+    size_t j = keep_small ? 0 : m;
+    size_t k = keep_small ? 0 : keep;
+    bool done = keep_small ? (keep == 0) : (k == 0);
+    
+    for (size_t c = 0; c < recv_chunks; ++c) {
+        comm_timer.start();
+        MPI_Wait(&recv_requests[c], MPI_STATUS_IGNORE);
+        timing.comm_time += comm_timer.stop();
+        
+        if (done) continue;
+        
+        bool complete = (c + 1 == recv_chunks);
+        size_t available = std::min(m, (c + 1) * chunk);
+        
+        merge_timer.start();
+        if (keep_small) {
+            while (k < keep) {
+                bool has_local = i < n;
+                bool has_partner = j < available;
+                if (has_local && has_partner) {
+                    out[k++] = (partner[j] < data[i]) ? partner[j++] : data[i++];
+                } else if (has_partner) {
+                    out[k++] = partner[j++];
+                } else if (has_local && complete) {
+                    out[k++] = data[i++];
+                } else {
+                    break;
+                }
+            }
+            done = (k == keep);
         } else {
-            merged.push_back(received[j++]);
+            while (k > 0) {
+                bool has_local = i > 0;
+                bool has_partner = j > m - available;
+                if (has_local && has_partner) {
+                    if (data[i - 1] < partner[j - 1]) {
+                        out[--k] = partner[--j];
+                    } else {
+                        out[--k] = data[--i];
+                    }
+                } else if (has_partner) {
+                    out[--k] = partner[--j];
+                } else if (has_local && complete) {
+                    out[--k] = data[--i];
+                } else {
+                    break;
+                }
+            }
+            done = (k == 0);
+        }
+        double merge_elapsed = merge_timer.stop();
+        timing.merge_time += merge_elapsed;
+        
+        // Merging counts as hidden communication only while chunks are
+        // still outstanding
+        if (!complete) {
+            timing.overlap_time += merge_elapsed;
         }
     }
-    while (i < data.size()) {
-        merged.push_back(data[i++]);
-    }
-    while (j < received.size()) {
-        merged.push_back(received[j++]);
+    
+    comm_timer.start();
+    MPI_Waitall(static_cast<int>(send_requests.size()), send_requests.data(), MPI_STATUSES_IGNORE);
+    timing.comm_time += comm_timer.stop();
+    
+    local_data.swap(buffers.kept);
+}
+
+/**
+ * The bitonic network with every block in shared memory
+ *
+ * Each rank's block lives in one of two buffers, the halves of its
+ * SharedWindow block. A step merges straight out of the rank's block and
+ * its partner's into the rank's other buffer, so blocks are never sent or
+ * copied. A per-rank header (count, current buffer), double-buffered by
+ * step parity, tells the partner where to read. One barrier per step
+ * separates the step's reads from the next step's writes: headers.sync(),
+ * with an MPI_Win_sync of the block window on either side of it. Peak
+ * memory is the two buffers, against the local, partner and kept blocks
+ * of the message-passing exchange.
+ */
+template <typename T>
+void shared_window_network(std::vector<T>& local_data,
+                           int rank,
+                           int size,
+                           int num_stages,
+                           size_t block_size,
+                           MPI_Comm comm,
+                           TimingData& timing,
+                           ThreadPool& pool) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    comm_timer.start();
+    SharedWindow<T> blocks(2 * block_size, comm);   // Buffer b at b * block_size
+    SharedWindow<std::int64_t> headers(4, comm);    // [parity] = {count, buffer}
+    
+    std::copy(local_data.begin(), local_data.end(), blocks.local());
+    std::int64_t count = local_data.size();
+    int current = 0;
+    std::vector<T>().swap(local_data);
+    timing.comm_time += comm_timer.stop();
+    
+    int parity = 0;
+    headers.local()[0] = count;
+    headers.local()[1] = current;
+    
+    for (int stage = 0; stage < num_stages; ++stage) {
+        for (int step = stage; step >= 0; --step) {
+            // Make every rank's last step visible
+            comm_timer.start();
+            blocks.fence();
+            headers.sync();
+            blocks.fence();
+            timing.comm_time += comm_timer.stop();
+            
+            int partner_rank = network_partner(rank, stage, step);
+            if (partner_rank >= size) {
+                timing.idle_steps++;
+            } else {
+                const std::int64_t* partner_header = headers.block(partner_rank) + 2 * parity;
+                const T* partner = blocks.block(partner_rank) + partner_header[1] * block_size;
+                const T* data = blocks.local() + current * block_size;
+                size_t n = count;
+                size_t m = partner_header[0];
+                
+                bool keep_small = rank < partner_rank;
+                size_t low_size = keep_small ? n : m;
+                size_t high_size = keep_small ? m : n;
+                
+                // The same merge-split rule as compare_exchange()
+                bool unchanged = high_size == 0;
+                if (!unchanged && low_size == block_size) {
+                    unchanged = keep_small ? !(partner[0] < data[n - 1])
+                                           : !(data[0] < partner[m - 1]);
+                }
+                if (!unchanged) {
+                    size_t kept_low = std::min(block_size, n + m);
+                    size_t keep = keep_small ? kept_low : n + m - kept_low;
+                    T* out = blocks.local() + (1 - current) * block_size;
+                    
+                    merge_timer.start();
+                    if (keep_small) {
+                        parallel_merge_range(data, n, partner, m, 0, keep, out, pool);
+                    } else {
+                        parallel_merge_range(partner, m, data, n, n + m - keep, keep, out, pool);
+                    }
+                    timing.merge_time += merge_timer.stop();
+                    timing.bytes_exchanged += n * sizeof(T);
+                    
+                    current = 1 - current;
+                    count = keep;
+                }
+            }
+            
+            // Publish where this block is for the next step
+            parity = 1 - parity;
+            headers.local()[2 * parity] = count;
+            headers.local()[2 * parity + 1] = current;
+        }
     }
     
-    // Keep only the second half
-    size_t start = merged.size() - data.size();
-    data.assign(merged.begin() + start, merged.end());
+    const T* data = blocks.local() + current * block_size;
+    local_data.assign(data, data + count);
+    
+    // Partners may still be reading the last step's blocks
+    comm_timer.start();
+    headers.sync();
+    timing.comm_time += comm_timer.stop();
 }
 
-void compare_exchange(std::vector<int>& local_data,
+} // namespace
+
+template <typename T>
+void compare_exchange(std::vector<T>& local_data,
                      int partner_rank,
                      bool keep_small,
-                     int rank,
                      MPI_Comm comm,
-                     double& comm_time) {
-    Timer comm_timer;
+                     TimingData& timing,
+                     ThreadPool& pool,
+                     BitonicBuffers<T>& buffers,
+                     size_t block_size,
+                     size_t pipeline_chunk) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
     comm_timer.start();
     
-    int local_size = local_data.size();
-    int partner_size;
+    // Exchange counts together with the boundary element the partner needs:
+    // the low side sends its maximum, the high side its minimum
+    ExchangeHeader<T> local_header;
+    ExchangeHeader<T> partner_header;
+    std::memset(static_cast<void*>(&local_header), 0, sizeof(local_header));
+    local_header.count = local_data.size();
+    if (!local_data.empty()) {
+        local_header.boundary = keep_small ? local_data.back() : local_data.front();
+    }
     
-    // Exchange sizes
-    MPI_Sendrecv(&local_size, 1, MPI_INT, partner_rank, 0,
-                 &partner_size, 1, MPI_INT, partner_rank, 0,
+    MPI_Sendrecv(&local_header, sizeof(local_header), MPI_BYTE, partner_rank, 0,
+                 &partner_header, sizeof(partner_header), MPI_BYTE, partner_rank, 0,
                  comm, MPI_STATUS_IGNORE);
     
-    // Exchange data
-    std::vector<int> partner_data(partner_size);
-    MPI_Sendrecv(local_data.data(), local_size, MPI_INT, partner_rank, 1,
-                 partner_data.data(), partner_size, MPI_INT, partner_rank, 1,
-                 comm, MPI_STATUS_IGNORE);
+    size_t local_size = local_data.size();
+    size_t partner_size = partner_header.count;
+    size_t low_size = keep_small ? local_size : partner_size;
+    size_t high_size = keep_small ? partner_size : local_size;
+    
+    // Both ranks reach the same verdict. Nothing moves when the high side
+    // is empty, or when the low side is a full block whose maximum does not
+    // exceed the high side's minimum.
+    bool unchanged = high_size == 0;
+    if (!unchanged && low_size == block_size) {
+        unchanged = keep_small ? !(partner_header.boundary < local_data.back())
+                               : !(local_data.front() < partner_header.boundary);
+    }
+    if (unchanged) {
+        timing.comm_time += comm_timer.stop();
+        return;
+    }
+    
+    // The low side keeps the smallest block_size keys of the pair, the high
+    // side whatever is left; virtual padding never travels
+    size_t kept_low = std::min(block_size, low_size + high_size);
+    size_t keep = keep_small ? kept_low : low_size + high_size - kept_low;
+    timing.bytes_exchanged += local_size * sizeof(T);
     
-    comm_time += comm_timer.stop();
+    // Both ranks see the same sizes, so they agree on the pipelined path
+    if (pipeline_chunk > 0 && std::max(local_size, partner_size) > pipeline_chunk) {
+        timing.comm_time += comm_timer.stop();
+        // Chunks travel as single int-count messages
+        size_t chunk = std::min(pipeline_chunk, max_message_elements());
+        pipelined_exchange_merge(local_data, partner_size, keep, partner_rank, keep_small,
+                                 comm, chunk, timing, buffers);
+        return;
+    }
+    
+    // Exchange data into the persistent partner buffer
+    buffers.partner.resize(partner_size);
+    large_sendrecv(local_data.data(), local_size, buffers.partner.data(), partner_size,
+                   partner_rank, 1, comm);
+    
+    timing.comm_time += comm_timer.stop();
     
-    // Merge and keep appropriate half
+    // Merge and keep appropriate part
+    merge_timer.start();
     if (keep_small) {
-        merge_low(local_data, partner_data);
+        merge_low(local_data, buffers.partner, keep, buffers.kept, pool);
     } else {
-        merge_high(local_data, partner_data);
+        merge_high(local_data, buffers.partner, keep, buffers.kept, pool);
     }
+    timing.merge_time += merge_timer.stop();
 }
 
-void bitonic_sort(std::vector<int>& local_data,
+template <typename T>
+void bitonic_sort(std::vector<T>& local_data,
                   int rank,
                   int size,
                   MPI_Comm comm,
-                  TimingData& timing) {
-    Timer total_timer, local_timer;
+                  TimingData& timing,
+                  const SortConfig& config) {
+    BitonicBuffers<T> buffers;
+    bitonic_sort(local_data, rank, size, comm, timing, config, buffers);
+}
+
+template <typename T>
+void bitonic_sort(std::vector<T>& local_data,
+                  int rank,
+                  int size,
+                  MPI_Comm comm,
+                  TimingData& timing,
+                  const SortConfig& config,
+                  BitonicBuffers<T>& buffers) {
+    Timer total_timer(&timing.total_counts, "bitonic_sort");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer other_timer(nullptr, "other");
     total_timer.start();
     
-    // Check if size is power of 2
-    if (!is_power_of_two(size)) {
-        if (rank == 0) {
-            std::cerr << "Warning: Bitonic sort works best with power-of-2 ranks. "
-                      << "Current size: " << size << std::endl;
-        }
-    }
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
     
     // Step 1: Local sort
     local_timer.start();
-    std::sort(local_data.begin(), local_data.end());
+    parallel_sort(local_data, pool, config.local_sort);
     timing.local_sort_time = local_timer.stop();
     
-    // Step 2: Bitonic merge network
-    // The algorithm has log²(p) stages
-    int num_stages = 0;
-    for (int temp = size; temp > 1; temp /= 2) {
-        num_stages++;
+    // Step 2: Every block counts as block_size keys, the missing ones being
+    // virtual +inf padding at its end. Padding is never stored or sent; the
+    // merge-split rule below accounts for it.
+    other_timer.start();
+    unsigned long long local_count = local_data.size();
+    unsigned long long block_size = 0;
+    MPI_Allreduce(&local_count, &block_size, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+    timing.padding_elements = block_size - local_count;
+    timing.other_time += other_timer.stop();
+    
+    // Step 3: Bitonic merge network over the next power of two ranks
+    // The algorithm has log²(p) stages. Every comparator puts the smaller
+    // half on the lower rank (the first step of each stage pairs mirrored
+    // ranks instead of using descending comparators), so ranks >= size act
+    // as virtual ranks full of +inf: their partner would keep its own block
+    // and the step is skipped.
+    int num_stages = ceil_log2(size);
+    
+    if (config.exchange == ExchangeMethod::Shared) {
+        shared_window_network(local_data, rank, size, num_stages, block_size, comm, timing, pool);
+        timing.total_time = total_timer.stop();
+        return;
     }
     
     for (int stage = 0; stage < num_stages; ++stage) {
         for (int step = stage; step >= 0; --step) {
-            int partner_distance = 1 << step;  // 2^step
-            int partner_rank = rank ^ partner_distance;
-            
-            if (partner_rank >= size) continue;
+            int partner_rank = network_partner(rank, stage, step);
             
-            // Determine direction of sorting for this stage
-            int stage_size = 1 << (stage + 1);  // 2^(stage+1)
-            bool ascending = ((rank / stage_size) % 2) == 0;
-            
-            // Determine if we keep small or large elements
-            bool keep_small;
-            if (rank < partner_rank) {
-                keep_small = ascending;
-            } else {
-                keep_small = !ascending;
+            if (partner_rank >= size) {
+                timing.idle_steps++;
+                continue;
             }
             
+            bool keep_small = rank < partner_rank;
+            
             // Perform compare-exchange
-            compare_exchange(local_data, partner_rank, keep_small, rank, comm, timing.comm_time);
+            compare_exchange(local_data, partner_rank, keep_small, comm, timing,
+                             pool, buffers, block_size, config.pipeline_chunk);
         }
     }
     
+    // Sorted rank r now holds the real keys among global positions
+    // [r * block_size, (r + 1) * block_size); counts may be unequal
     timing.total_time = total_timer.stop();
 }
+
+#define INSTANTIATE_BITONIC(T) \
+    template void bitonic_sort<T>(std::vector<T>&, int, int, MPI_Comm, TimingData&, \
+                                  const SortConfig&); \
+    template void bitonic_sort<T>(std::vector<T>&, int, int, MPI_Comm, TimingData&, \
+                                  const SortConfig&, BitonicBuffers<T>&); \
+    template void compare_exchange<T>(std::vector<T>&, int, bool, MPI_Comm, TimingData&, \
+                                      ThreadPool&, BitonicBuffers<T>&, size_t, size_t); \
+    template void merge_low<T>(std::vector<T>&, const std::vector<T>&, size_t, \
+                               std::vector<T>&, ThreadPool&); \
+    template void merge_high<T>(std::vector<T>&, const std::vector<T>&, size_t, \
+                                std::vector<T>&, ThreadPool&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_BITONIC)
@@ -0,0 +1,167 @@
+#include "distributed_radix_sort.h"
+#include "radix_sort.h"
+#include "hierarchical_exchange.h"
+#include "bitonic_sort.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// Top-digit width: enough digits per rank for an even split, bounded so
+// the histogram allreduce stays small
+constexpr int DIGITS_PER_RANK_BITS = 10;
+constexpr int MAX_DIGIT_BITS = 16;
+
+} // namespace
+
+template <typename T>
+void distributed_radix_sort(std::vector<T>& local_data,
+                            int rank,
+                            int size,
+                            MPI_Comm comm,
+                            TimingData& timing,
+                            const SortConfig& config) {
+    Timer total_timer(&timing.total_counts, "distributed_radix_sort");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
+
+    // Step 1: Global key range; the largest key travels complemented so
+    // one MIN reduction finds both ends
+    local_timer.start();
+    unsigned long long bounds[2] = {ULLONG_MAX, ULLONG_MAX};
+    for (const T& value : local_data) {
+        unsigned long long key = element_radix_key(value);
+        bounds[0] = std::min(bounds[0], key);
+        bounds[1] = std::min(bounds[1], ~key);
+    }
+    timing.local_sort_time += local_timer.stop();
+    unsigned long long global_bounds[2];
+    comm_timer.start();
+    MPI_Allreduce(bounds, global_bounds, 2, MPI_UNSIGNED_LONG_LONG, MPI_MIN, comm);
+    timing.comm_time += comm_timer.stop();
+    unsigned long long min_key = global_bounds[0];
+    unsigned long long max_key = ~global_bounds[1];
+
+    // No data, or every key equal: already sorted where it is
+    if (min_key >= max_key) {
+        timing.total_time = total_timer.stop();
+        return;
+    }
+
+    int high_bit = 63 - __builtin_clzll(min_key ^ max_key);
+    int digit_bits = std::min({MAX_DIGIT_BITS, ceil_log2(size) + DIGITS_PER_RANK_BITS, high_bit + 1});
+    int shift = high_bit + 1 - digit_bits;
+    unsigned long long base = min_key >> shift;
+    size_t num_digits = static_cast<size_t>((max_key >> shift) - base) + 1;
+    auto digit_of = [&](const T& value) {
+        return static_cast<size_t>((static_cast<unsigned long long>(element_radix_key(value)) >> shift) - base);
+    };
+
+    // Step 2: Local and global top-digit histograms
+    local_timer.start();
+    std::vector<long long> local_hist(num_digits, 0);
+    for (const T& value : local_data) {
+        local_hist[digit_of(value)]++;
+    }
+    timing.local_sort_time += local_timer.stop();
+    std::vector<long long> global_hist(num_digits);
+    comm_timer.start();
+    MPI_Allreduce(local_hist.data(), global_hist.data(), static_cast<int>(num_digits),
+                  MPI_LONG_LONG, MPI_SUM, comm);
+    timing.comm_time += comm_timer.stop();
+
+    // Step 3: Digit range of every rank, boundaries nearest to i * n/p
+    std::vector<long long> prefix(num_digits + 1, 0);
+    for (size_t d = 0; d < num_digits; ++d) {
+        prefix[d + 1] = prefix[d] + global_hist[d];
+    }
+    long long n = prefix[num_digits];
+    std::vector<size_t> first_digit(size + 1, 0);
+    first_digit[size] = num_digits;
+    for (int r = 1; r < size; ++r) {
+        long long target = static_cast<long long>(static_cast<long double>(n) * r / size);
+        size_t d = std::lower_bound(prefix.begin() + first_digit[r - 1], prefix.end(), target)
+                 - prefix.begin();
+        if (d > first_digit[r - 1] && target - prefix[d - 1] < prefix[d] - target) d--;
+        first_digit[r] = std::min(d, num_digits);
+    }
+
+    // Step 4: Counting sort by top digit, which groups by destination
+    local_timer.start();
+    std::vector<long long> offsets(num_digits);
+    long long running = 0;
+    for (size_t d = 0; d < num_digits; ++d) {
+        offsets[d] = running;
+        running += local_hist[d];
+    }
+    std::vector<T> grouped(local_data.size());
+    for (const T& value : local_data) {
+        grouped[offsets[digit_of(value)]++] = value;
+    }
+    std::vector<long long> send_counts(size, 0);
+    std::vector<long long> send_displs(size, 0);
+    for (int r = 0, d = 0; r < size; ++r) {
+        send_displs[r] = r > 0 ? send_displs[r - 1] + send_counts[r - 1] : 0;
+        for (; d < static_cast<int>(first_digit[r + 1]); ++d) {
+            send_counts[r] += local_hist[d];
+        }
+    }
+    std::vector<long long>().swap(local_hist);
+    timing.local_sort_time += local_timer.stop();
+
+    // Step 5: One all-to-all exchange
+    comm_timer.start();
+    std::vector<long long> recv_counts(size);
+    std::vector<long long> recv_displs(size);
+    MPI_Alltoall(send_counts.data(), 1, MPI_LONG_LONG, recv_counts.data(), 1, MPI_LONG_LONG, comm);
+    long long recv_total = 0;
+    for (int r = 0; r < size; ++r) {
+        recv_displs[r] = recv_total;
+        recv_total += recv_counts[r];
+        if (r != rank) timing.bytes_exchanged += send_counts[r] * sizeof(T);
+    }
+    std::vector<T> received(recv_total);
+    alltoallv_exchange(grouped.data(), send_counts, send_displs,
+                       received.data(), recv_counts, recv_displs, comm, config.exchange);
+    timing.comm_time += comm_timer.stop();
+    std::vector<T>().swap(grouped);
+
+    // Step 6: Scatter by top digit into place, then sort every bucket on
+    // the remaining bits with the received buffer as scratch
+    merge_timer.start();
+    size_t my_first = first_digit[rank];
+    size_t my_digits = first_digit[rank + 1] - my_first;
+    std::vector<long long> bucket_start(my_digits + 1);
+    for (size_t d = 0; d <= my_digits; ++d) {
+        bucket_start[d] = prefix[my_first + d] - prefix[my_first];
+    }
+    std::vector<long long> fill(bucket_start.begin(), bucket_start.end() - 1);
+    local_data.resize(recv_total);
+    for (const T& value : received) {
+        local_data[fill[digit_of(value) - my_first]++] = value;
+    }
+    auto sort_bucket = [&](size_t d) {
+        long long first = bucket_start[d];
+        long long count = bucket_start[d + 1] - first;
+        if (count > 1) {
+            radix_sort(local_data.data() + first, count, received.data() + first);
+        }
+    };
+    if (pool.size() > 1) {
+        pool.parallel_for(static_cast<int>(my_digits), [&](int d) { sort_bucket(d); });
+    } else {
+        for (size_t d = 0; d < my_digits; ++d) sort_bucket(d);
+    }
+    timing.merge_time += merge_timer.stop();
+
+    timing.total_time = total_timer.stop();
+}
+
+#define INSTANTIATE_DISTRIBUTED_RADIX(T) \
+    template void distributed_radix_sort<T>(std::vector<T>&, int, int, MPI_Comm, TimingData&, \
+                                            const SortConfig&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_DISTRIBUTED_RADIX)
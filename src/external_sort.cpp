@@ -0,0 +1,441 @@
+#include "external_sort.h"
+#include "psrs_sort.h"
+#include "parallel_kernels.h"
+#include "large_count.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <unistd.h>
+
+namespace {
+
+// Bytes per read buffer in the streaming merge (less for small budgets)
+constexpr size_t MERGE_BLOCK_BYTES = 1 << 20;
+
+struct RunFile {
+    std::string path;
+    size_t count;
+};
+
+[[noreturn]] void spill_failure(const std::string& path, const char* what) {
+    std::cerr << "Error: cannot " << what << " spill file " << path << ": "
+              << std::strerror(errno) << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    std::abort();
+}
+
+std::string spill_path(const std::string& dir, int rank, const std::string& tag) {
+    return dir + "/psort_" + std::to_string(getpid()) + "_r" + std::to_string(rank)
+         + "_" + tag + ".bin";
+}
+
+template <typename T>
+void write_run(const std::string& path, const T* data, size_t count, TimingData& timing) {
+    Timer io_timer(nullptr, "spill_io");
+    io_timer.start();
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) spill_failure(path, "create");
+    if (count > 0 && std::fwrite(data, sizeof(T), count, file) != count) {
+        spill_failure(path, "write");
+    }
+    std::fclose(file);
+    timing.io_time += io_timer.stop();
+    timing.spill_bytes += count * sizeof(T);
+}
+
+template <typename T>
+void read_run(const RunFile& run, std::vector<T>& data, TimingData& timing) {
+    Timer io_timer(nullptr, "spill_io");
+    io_timer.start();
+    data.resize(run.count);
+    std::FILE* file = std::fopen(run.path.c_str(), "rb");
+    if (!file) spill_failure(run.path, "open");
+    if (run.count > 0 && std::fread(data.data(), sizeof(T), run.count, file) != run.count) {
+        spill_failure(run.path, "read");
+    }
+    std::fclose(file);
+    timing.io_time += io_timer.stop();
+}
+
+// Sequential reader over a run file, one block in memory at a time
+template <typename T>
+class BlockReader {
+private:
+    std::FILE* file;
+    std::string path;
+    std::vector<T> block;
+    size_t block_elements;
+    size_t pos = 0;
+    size_t remaining;
+    TimingData* timing;
+
+    void refill() {
+        Timer io_timer(nullptr, "spill_io");
+        io_timer.start();
+        block.resize(std::min(block_elements, remaining));
+        if (std::fread(block.data(), sizeof(T), block.size(), file) != block.size()) {
+            spill_failure(path, "read");
+        }
+        remaining -= block.size();
+        pos = 0;
+        timing->io_time += io_timer.stop();
+    }
+
+public:
+    BlockReader(const RunFile& run, size_t block_size, TimingData& timing_data)
+        : path(run.path), block_elements(block_size), remaining(run.count),
+          timing(&timing_data) {
+        file = std::fopen(path.c_str(), "rb");
+        if (!file) spill_failure(path, "open");
+        if (remaining > 0) refill();
+    }
+
+    ~BlockReader() { std::fclose(file); }
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    bool empty() const { return pos == block.size() && remaining == 0; }
+    const T& front() const { return block[pos]; }
+
+    void pop() {
+        if (++pos == block.size() && remaining > 0) {
+            refill();
+        }
+    }
+};
+
+// Sequential writer that flushes whole blocks
+template <typename T>
+class BlockWriter {
+private:
+    std::FILE* file;
+    std::string path;
+    std::vector<T> block;
+    size_t count = 0;
+    TimingData* timing;
+
+    void flush() {
+        if (block.empty()) return;
+        Timer io_timer(nullptr, "spill_io");
+        io_timer.start();
+        if (std::fwrite(block.data(), sizeof(T), block.size(), file) != block.size()) {
+            spill_failure(path, "write");
+        }
+        timing->io_time += io_timer.stop();
+        timing->spill_bytes += block.size() * sizeof(T);
+        block.clear();
+    }
+
+public:
+    BlockWriter(const std::string& out_path, size_t block_elements, TimingData& timing_data)
+        : path(out_path), timing(&timing_data) {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) spill_failure(path, "create");
+        block.reserve(block_elements);
+    }
+
+    ~BlockWriter() { std::fclose(file); }
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+
+    void push(const T& value) {
+        block.push_back(value);
+        count++;
+        if (block.size() == block.capacity()) flush();
+    }
+
+    size_t finish() {
+        flush();
+        std::fflush(file);
+        return count;
+    }
+};
+
+// Streaming k-way merge of sorted run files into one file; ties go to the
+// earlier run, so the merge is stable across runs
+template <typename T>
+size_t merge_run_files(const std::vector<RunFile>& runs,
+                       const std::string& out_path,
+                       size_t block_elements,
+                       TimingData& timing) {
+    std::vector<std::unique_ptr<BlockReader<T>>> readers;
+    for (const RunFile& run : runs) {
+        readers.emplace_back(new BlockReader<T>(run, block_elements, timing));
+    }
+
+    auto later = [&](size_t a, size_t b) {
+        const T& x = readers[a]->front();
+        const T& y = readers[b]->front();
+        if (y < x) return true;
+        return !(x < y) && b < a;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t k = 0; k < readers.size(); ++k) {
+        if (!readers[k]->empty()) heap.push(k);
+    }
+
+    BlockWriter<T> writer(out_path, block_elements, timing);
+    while (!heap.empty()) {
+        size_t k = heap.top();
+        heap.pop();
+        writer.push(readers[k]->front());
+        readers[k]->pop();
+        if (!readers[k]->empty()) heap.push(k);
+    }
+    return writer.finish();
+}
+
+void remove_runs(const std::vector<RunFile>& runs) {
+    for (const RunFile& run : runs) {
+        std::remove(run.path.c_str());
+    }
+}
+
+} // namespace
+
+template <typename T>
+size_t run_elements(const SortConfig& config) {
+    return std::max<size_t>(1, config.memory_budget / (3 * sizeof(T)));
+}
+
+template <typename T>
+size_t external_sort(const std::string& input_path,
+                     const std::string& output_path,
+                     int rank,
+                     int size,
+                     MPI_Comm comm,
+                     TimingData& timing,
+                     const SortConfig& config) {
+    Timer total_timer(&timing.total_counts, "external_sort");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
+    size_t capacity = run_elements<T>(config);
+    size_t block_bytes = std::max(sizeof(T), std::min(MERGE_BLOCK_BYTES, config.memory_budget / 4));
+    size_t block_elements = block_bytes / sizeof(T);
+
+    // Step 1: Run formation - read, sort, sample and spill one run at a time
+    std::vector<RunFile> local_runs;
+    std::vector<std::vector<T>> run_samples;
+    std::vector<T> run;
+    {
+        std::FILE* input = std::fopen(input_path.c_str(), "rb");
+        if (!input) spill_failure(input_path, "open");
+        std::fseek(input, 0, SEEK_END);
+        size_t remaining = std::ftell(input) / sizeof(T);
+        std::fseek(input, 0, SEEK_SET);
+        while (remaining > 0) {
+            Timer io_timer(nullptr, "spill_io");
+            io_timer.start();
+            run.resize(std::min(capacity, remaining));
+            size_t n = std::fread(run.data(), sizeof(T), run.size(), input);
+            if (n != run.size()) spill_failure(input_path, "read");
+            remaining -= n;
+            timing.io_time += io_timer.stop();
+
+            local_timer.start();
+            parallel_sort(run, pool, config.local_sort);
+            timing.local_sort_time += local_timer.stop();
+
+            run_samples.emplace_back();
+            select_regular_samples(run, run_samples.back(), size * config.oversampling);
+
+            RunFile file{spill_path(config.spill_dir, rank, "run" + std::to_string(local_runs.size())), n};
+            write_run(file.path, run.data(), n, timing);
+            local_runs.push_back(file);
+        }
+        std::fclose(input);
+    }
+
+    // Step 2: Tagged pivots from the samples of every run. A run's tag rank
+    // orders it after all runs of lower ranks and earlier runs of its own.
+    comm_timer.start();
+    int local_run_count = local_runs.size();
+    int max_runs = 0;
+    MPI_Allreduce(&local_run_count, &max_runs, 1, MPI_INT, MPI_MAX, comm);
+    timing.comm_time += comm_timer.stop();
+
+    std::vector<TaggedPivot<T>> local_samples;
+    for (size_t r = 0; r < run_samples.size(); ++r) {
+        size_t step = std::max<size_t>(1, local_runs[r].count / (size * config.oversampling));
+        for (size_t i = 0; i < run_samples[r].size(); ++i) {
+            local_samples.push_back({run_samples[r][i], rank * max_runs + static_cast<int>(r),
+                                     static_cast<long long>(i * step)});
+        }
+    }
+
+    comm_timer.start();
+    MPI_Datatype sample_type = mpi_type<TaggedPivot<T>>();
+    int local_sample_count = local_samples.size();
+    std::vector<int> sample_counts(size);
+    std::vector<int> sample_displs(size);
+    MPI_Gather(&local_sample_count, 1, MPI_INT, sample_counts.data(), 1, MPI_INT, 0, comm);
+    std::vector<TaggedPivot<T>> all_samples;
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; ++r) {
+            sample_displs[r] = total;
+            total += sample_counts[r];
+        }
+        all_samples.resize(total);
+    }
+    MPI_Gatherv(local_samples.data(), local_sample_count, sample_type,
+                all_samples.data(), sample_counts.data(), sample_displs.data(), sample_type,
+                0, comm);
+    timing.comm_time += comm_timer.stop();
+
+    std::vector<TaggedPivot<T>> pivots(size - 1);
+    if (rank == 0 && !all_samples.empty()) {
+        std::sort(all_samples.begin(), all_samples.end());
+        size_t total_samples = all_samples.size();
+        for (int i = 0; i < size - 1; ++i) {
+            pivots[i] = all_samples[std::min(total_samples - 1, (i + 1) * total_samples / size)];
+        }
+    }
+    comm_timer.start();
+    MPI_Bcast(pivots.data(), size - 1, sample_type, 0, comm);
+    timing.comm_time += comm_timer.stop();
+
+    // Step 3: Exchange one run per round and spill the merged pieces. A
+    // rank accepts at most capacity elements per exchange; under skew the
+    // rest of the pieces follow in further exchanges of the same round.
+    std::vector<RunFile> received_runs;
+    std::vector<long long> send_counts(size);
+    std::vector<long long> send_displs(size);
+    std::vector<long long> pending(size);
+    std::vector<long long> offered(size);
+    std::vector<long long> recv_counts(size);
+    std::vector<long long> recv_displs(size);
+    std::vector<T> recv_buffer;
+    std::vector<T> merged;
+    for (int r = 0; r < max_runs; ++r) {
+        run.clear();
+        if (r < local_run_count) {
+            read_run(local_runs[r], run, timing);
+            std::remove(local_runs[r].path.c_str());
+        }
+
+        merge_timer.start();
+        partition_by_pivots(run, rank * max_runs + r, pivots, pending, send_displs);
+        timing.merge_time += merge_timer.stop();
+
+        for (int part = 0;; ++part) {
+            // Offer what is left, grant in source order up to capacity
+            comm_timer.start();
+            MPI_Alltoall(pending.data(), 1, MPI_LONG_LONG, offered.data(), 1, MPI_LONG_LONG, comm);
+            long long recv_total = 0;
+            for (int i = 0; i < size; ++i) {
+                recv_displs[i] = recv_total;
+                recv_counts[i] = std::min(offered[i], static_cast<long long>(capacity) - recv_total);
+                recv_total += recv_counts[i];
+            }
+            MPI_Alltoall(recv_counts.data(), 1, MPI_LONG_LONG, send_counts.data(), 1, MPI_LONG_LONG, comm);
+            recv_buffer.resize(recv_total);
+            large_alltoallv(run.data(), send_counts, send_displs,
+                            recv_buffer.data(), recv_counts, recv_displs, comm);
+            long long local_left = 0;
+            for (int i = 0; i < size; ++i) {
+                if (i != rank) timing.bytes_exchanged += send_counts[i] * sizeof(T);
+                send_displs[i] += send_counts[i];
+                pending[i] -= send_counts[i];
+                local_left += pending[i];
+            }
+            long long left = 0;
+            MPI_Allreduce(&local_left, &left, 1, MPI_LONG_LONG, MPI_MAX, comm);
+            timing.comm_time += comm_timer.stop();
+
+            if (recv_total > 0) {
+                merge_timer.start();
+                merge_partitions(recv_buffer, recv_displs, recv_counts, merged, pool);
+                timing.merge_time += merge_timer.stop();
+
+                RunFile file{spill_path(config.spill_dir, rank,
+                                        "recv" + std::to_string(r) + "_" + std::to_string(part)),
+                             merged.size()};
+                write_run(file.path, merged.data(), merged.size(), timing);
+                received_runs.push_back(file);
+            }
+            if (left == 0) break;
+        }
+    }
+    std::vector<T>().swap(run);
+    std::vector<T>().swap(recv_buffer);
+    std::vector<T>().swap(merged);
+
+    // Step 4: Streaming k-way merge; intermediate passes keep the number of
+    // open read buffers within the memory budget
+    merge_timer.start();
+    double io_before = timing.io_time;
+    size_t fan_in = std::max<size_t>(2, config.memory_budget / block_bytes - 1);
+    int pass = 0;
+    while (received_runs.size() > fan_in) {
+        std::vector<RunFile> next;
+        for (size_t first = 0; first < received_runs.size(); first += fan_in) {
+            size_t last = std::min(received_runs.size(), first + fan_in);
+            std::vector<RunFile> group(received_runs.begin() + first, received_runs.begin() + last);
+            RunFile file{spill_path(config.spill_dir, rank,
+                                    "pass" + std::to_string(pass) + "_" + std::to_string(first)), 0};
+            file.count = merge_run_files<T>(group, file.path, block_elements, timing);
+            remove_runs(group);
+            next.push_back(file);
+        }
+        received_runs.swap(next);
+        pass++;
+    }
+    size_t output_count = merge_run_files<T>(received_runs, output_path, block_elements, timing);
+    remove_runs(received_runs);
+    timing.merge_time += merge_timer.stop() - (timing.io_time - io_before);
+
+    timing.total_time = total_timer.stop();
+    return output_count;
+}
+
+template <typename T>
+bool verify_sorted_file(const std::string& path, int rank, int size, MPI_Comm comm) {
+    TimingData scratch;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) spill_failure(path, "open");
+    std::fseek(file, 0, SEEK_END);
+    size_t count = std::ftell(file) / sizeof(T);
+    std::fclose(file);
+
+    // Check local sorting block by block
+    bool local_ok = true;
+    bool has_data = false;
+    T first_value = T();
+    T previous = T();
+    {
+        BlockReader<T> reader(RunFile{path, count}, MERGE_BLOCK_BYTES / sizeof(T) + 1, scratch);
+        while (!reader.empty()) {
+            const T& value = reader.front();
+            if (!has_data) {
+                first_value = value;
+                has_data = true;
+            } else if (value < previous) {
+                local_ok = false;
+            }
+            previous = value;
+            reader.pop();
+        }
+    }
+    if (!local_ok) {
+        std::cerr << "Rank " << rank << ": Local data not sorted!" << std::endl;
+    }
+
+    return verify_rank_boundaries(local_ok, has_data, first_value, previous, rank, size, comm);
+}
+
+#define INSTANTIATE_EXTERNAL_SORT(T) \
+    template size_t external_sort<T>(const std::string&, const std::string&, int, int, \
+                                     MPI_Comm, TimingData&, const SortConfig&); \
+    template size_t run_elements<T>(const SortConfig&); \
+    template bool verify_sorted_file<T>(const std::string&, int, int, MPI_Comm);
+FOR_EACH_SORT_TYPE(INSTANTIATE_EXTERNAL_SORT)
@@ -0,0 +1,81 @@
+#include "memory_usage.h"
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+// Replacements for every global allocation function, feeding the heap
+// counters of memory_usage.h. Only the benchmark links this file, so the
+// library never replaces an application's allocator. The sized and
+// aligned deletes ignore the extra argument: malloc_usable_size() tells
+// the size, and free() releases posix_memalign blocks too.
+
+namespace {
+    
+// malloc or posix_memalign, retrying through the new handler like the
+// library operator new
+void* allocate(size_t size, size_t alignment) {
+    if (size == 0) size = 1;
+    while (true) {
+        void* block = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            block = std::malloc(size);
+        } else if (posix_memalign(&block, alignment, size) != 0) {
+            block = nullptr;
+        }
+        if (block) {
+            heap_record_allocation(malloc_usable_size(block));
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) return nullptr;
+        handler();
+    }
+}
+    
+void* allocate_or_throw(size_t size, size_t alignment) {
+    void* block = allocate(size, alignment);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+    
+void deallocate(void* block) {
+    if (!block) return;
+    heap_record_free(malloc_usable_size(block));
+    std::free(block);
+}
+    
+} // namespace
+
+void* operator new(size_t size) { return allocate_or_throw(size, 0); }
+void* operator new[](size_t size) { return allocate_or_throw(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block) noexcept { deallocate(block); }
+void operator delete[](void* block) noexcept { deallocate(block); }
+void operator delete(void* block, size_t) noexcept { deallocate(block); }
+void operator delete[](void* block, size_t) noexcept { deallocate(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { deallocate(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { deallocate(block); }
+void operator delete(void* block, std::align_val_t) noexcept { deallocate(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { deallocate(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { deallocate(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { deallocate(block); }
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+    deallocate(block);
+}
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept {
+    deallocate(block);
+}
@@ -0,0 +1,255 @@
+#include "hierarchical_exchange.h"
+#include "shared_window.h"
+#include "large_count.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Ranks of a communicator grouped by shared-memory node
+struct NodeTopology {
+    MPI_Comm node_comm;     // Ranks on this node, ordered by rank in comm
+    MPI_Comm leader_comm;   // Lowest rank of every node; MPI_COMM_NULL elsewhere
+    int node;               // This rank's node: its leader's rank in leader_comm
+    std::vector<std::vector<int>> members;  // Ranks of every node, ascending
+};
+
+int topology_keyval = MPI_KEYVAL_INVALID;
+
+int free_topology(MPI_Comm, int, void* attribute, void*) {
+    NodeTopology* topology = static_cast<NodeTopology*>(attribute);
+    MPI_Comm_free(&topology->node_comm);
+    if (topology->leader_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&topology->leader_comm);
+    }
+    delete topology;
+    return MPI_SUCCESS;
+}
+
+// The node grouping of comm, built on first use and cached as an attribute
+const NodeTopology& node_topology(MPI_Comm comm) {
+    if (topology_keyval == MPI_KEYVAL_INVALID) {
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, free_topology, &topology_keyval, nullptr);
+    }
+    void* attribute = nullptr;
+    int found = 0;
+    MPI_Comm_get_attr(comm, topology_keyval, &attribute, &found);
+    if (found) {
+        return *static_cast<NodeTopology*>(attribute);
+    }
+
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    NodeTopology* topology = new NodeTopology;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &topology->node_comm);
+    int node_rank;
+    MPI_Comm_rank(topology->node_comm, &node_rank);
+    MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &topology->leader_comm);
+
+    topology->node = 0;
+    if (node_rank == 0) {
+        MPI_Comm_rank(topology->leader_comm, &topology->node);
+    }
+    MPI_Bcast(&topology->node, 1, MPI_INT, 0, topology->node_comm);
+
+    std::vector<int> node_of(size);
+    MPI_Allgather(&topology->node, 1, MPI_INT, node_of.data(), 1, MPI_INT, comm);
+    int num_nodes = *std::max_element(node_of.begin(), node_of.end()) + 1;
+    topology->members.resize(num_nodes);
+    for (int r = 0; r < size; ++r) {
+        topology->members[node_of[r]].push_back(r);
+    }
+
+    MPI_Comm_set_attr(comm, topology_keyval, topology);
+    return *topology;
+}
+
+long long sum(const long long* counts, int n) {
+    return std::accumulate(counts, counts + n, 0LL);
+}
+
+} // namespace
+
+int shared_memory_nodes(MPI_Comm comm) {
+    return node_topology(comm).members.size();
+}
+
+template <typename T>
+void hierarchical_alltoallv(const T* send_buffer,
+                            const std::vector<long long>& send_counts,
+                            const std::vector<long long>& send_displs,
+                            T* recv_buffer,
+                            const std::vector<long long>& recv_counts,
+                            const std::vector<long long>& recv_displs,
+                            MPI_Comm comm) {
+    const NodeTopology& topology = node_topology(comm);
+    MPI_Datatype type = mpi_type<T>();
+    int size = send_counts.size();
+    int node_rank, node_size;
+    MPI_Comm_rank(topology.node_comm, &node_rank);
+    MPI_Comm_size(topology.node_comm, &node_size);
+    bool leader = node_rank == 0;
+    int num_nodes = topology.members.size();
+
+    // Step 1: The leader gathers every member's counts in both directions
+    // and its whole send buffer; bucket (i, dst) is member i's run for dst
+    std::vector<long long> member_send_counts(leader ? node_size * size : 0);
+    std::vector<long long> member_recv_counts(leader ? node_size * size : 0);
+    MPI_Gather(send_counts.data(), size, MPI_LONG_LONG,
+               member_send_counts.data(), size, MPI_LONG_LONG, 0, topology.node_comm);
+    MPI_Gather(recv_counts.data(), size, MPI_LONG_LONG,
+               member_recv_counts.data(), size, MPI_LONG_LONG, 0, topology.node_comm);
+
+    std::vector<int> gather_counts(node_size, 0);
+    std::vector<int> gather_displs(node_size, 0);
+    std::vector<int> scatter_counts(node_size, 0);
+    std::vector<int> scatter_displs(node_size, 0);
+    int local_fit = 1;
+    if (leader) {
+        long long gather_total = 0;
+        long long scatter_total = 0;
+        for (int i = 0; i < node_size; ++i) {
+            long long gather_count = sum(&member_send_counts[i * size], size);
+            long long scatter_count = sum(&member_recv_counts[i * size], size);
+            gather_counts[i] = static_cast<int>(gather_count);
+            gather_displs[i] = static_cast<int>(gather_total);
+            gather_total += gather_count;
+            scatter_counts[i] = static_cast<int>(scatter_count);
+            scatter_displs[i] = static_cast<int>(scatter_total);
+            scatter_total += scatter_count;
+        }
+        long long limit = static_cast<long long>(max_message_elements());
+        local_fit = gather_total <= limit && scatter_total <= limit;
+    }
+
+    // A node's aggregate bounds every count and displacement below, so if
+    // any node's exceeds one int-count call, every rank takes the flat
+    // large-count exchange instead
+    int fit = 0;
+    MPI_Allreduce(&local_fit, &fit, 1, MPI_INT, MPI_LAND, comm);
+    if (!fit) {
+        large_alltoallv(send_buffer, send_counts, send_displs,
+                        recv_buffer, recv_counts, recv_displs, comm);
+        return;
+    }
+    std::vector<T> gathered(leader ? gather_displs.back() + gather_counts.back() : 0);
+    MPI_Gatherv(send_buffer + send_displs[0], static_cast<int>(sum(send_counts.data(), size)), type,
+                gathered.data(), gather_counts.data(), gather_displs.data(), type,
+                0, topology.node_comm);
+
+    std::vector<T> scattered;
+    if (leader) {
+        // Step 2: One block per destination node: for each rank of that
+        // node in turn, the buckets from every member of this node
+        std::vector<size_t> bucket_offsets(node_size * size);
+        for (int i = 0; i < node_size; ++i) {
+            size_t offset = gather_displs[i];
+            for (int dst = 0; dst < size; ++dst) {
+                bucket_offsets[i * size + dst] = offset;
+                offset += member_send_counts[i * size + dst];
+            }
+        }
+
+        std::vector<T> outgoing(gathered.size());
+        std::vector<int> node_send_counts(num_nodes, 0);
+        std::vector<int> node_send_displs(num_nodes, 0);
+        size_t position = 0;
+        for (int m = 0; m < num_nodes; ++m) {
+            node_send_displs[m] = position;
+            for (int dst : topology.members[m]) {
+                for (int i = 0; i < node_size; ++i) {
+                    const T* bucket = gathered.data() + bucket_offsets[i * size + dst];
+                    long long count = member_send_counts[i * size + dst];
+                    std::copy(bucket, bucket + count, outgoing.data() + position);
+                    position += count;
+                }
+            }
+            node_send_counts[m] = position - node_send_displs[m];
+        }
+        std::vector<T>().swap(gathered);
+
+        // Step 3: Inter-node exchange among leaders; the block from node n
+        // holds, for each member here, the buckets from every rank of n
+        std::vector<int> node_recv_counts(num_nodes, 0);
+        std::vector<int> node_recv_displs(num_nodes, 0);
+        int incoming_total = 0;
+        for (int n = 0; n < num_nodes; ++n) {
+            for (int j = 0; j < node_size; ++j) {
+                for (int src : topology.members[n]) {
+                    node_recv_counts[n] += member_recv_counts[j * size + src];
+                }
+            }
+            node_recv_displs[n] = incoming_total;
+            incoming_total += node_recv_counts[n];
+        }
+        std::vector<T> incoming(incoming_total);
+        MPI_Alltoallv(outgoing.data(), node_send_counts.data(), node_send_displs.data(), type,
+                      incoming.data(), node_recv_counts.data(), node_recv_displs.data(), type,
+                      topology.leader_comm);
+        std::vector<T>().swap(outgoing);
+
+        // Step 4: Lay out every member's receive buffer in source rank order
+        std::vector<size_t> run_offsets(node_size * size);
+        for (int j = 0; j < node_size; ++j) {
+            size_t offset = scatter_displs[j];
+            for (int src = 0; src < size; ++src) {
+                run_offsets[j * size + src] = offset;
+                offset += member_recv_counts[j * size + src];
+            }
+        }
+
+        scattered.resize(incoming.size());
+        for (int n = 0; n < num_nodes; ++n) {
+            const T* block = incoming.data() + node_recv_displs[n];
+            for (int j = 0; j < node_size; ++j) {
+                for (int src : topology.members[n]) {
+                    long long count = member_recv_counts[j * size + src];
+                    std::copy(block, block + count, scattered.data() + run_offsets[j * size + src]);
+                    block += count;
+                }
+            }
+        }
+    }
+
+    // Node-local scatter of the receive buffers
+    MPI_Scatterv(scattered.data(), scatter_counts.data(), scatter_displs.data(), type,
+                 recv_buffer + recv_displs[0], static_cast<int>(sum(recv_counts.data(), size)), type,
+                 0, topology.node_comm);
+}
+
+template <typename T>
+void alltoallv_exchange(const T* send_buffer,
+                        const std::vector<long long>& send_counts,
+                        const std::vector<long long>& send_displs,
+                        T* recv_buffer,
+                        const std::vector<long long>& recv_counts,
+                        const std::vector<long long>& recv_displs,
+                        MPI_Comm comm,
+                        ExchangeMethod method) {
+    if (method == ExchangeMethod::Hierarchical) {
+        hierarchical_alltoallv(send_buffer, send_counts, send_displs,
+                               recv_buffer, recv_counts, recv_displs, comm);
+        return;
+    }
+    if (method == ExchangeMethod::Shared) {
+        shared_alltoallv(send_buffer, send_counts, send_displs,
+                         recv_buffer, recv_counts, recv_displs, comm);
+        return;
+    }
+    large_alltoallv(send_buffer, send_counts, send_displs,
+                    recv_buffer, recv_counts, recv_displs, comm);
+}
+
+#define INSTANTIATE_EXCHANGE(T) \
+    template void hierarchical_alltoallv<T>(const T*, const std::vector<long long>&, \
+                                            const std::vector<long long>&, T*, \
+                                            const std::vector<long long>&, \
+                                            const std::vector<long long>&, MPI_Comm); \
+    template void alltoallv_exchange<T>(const T*, const std::vector<long long>&, \
+                                        const std::vector<long long>&, T*, \
+                                        const std::vector<long long>&, \
+                                        const std::vector<long long>&, MPI_Comm, ExchangeMethod);
+FOR_EACH_SORT_TYPE(INSTANTIATE_EXCHANGE)
+INSTANTIATE_EXCHANGE(FixedPayload<56>)
@@ -0,0 +1,141 @@
+#include "large_count.h"
+#include <algorithm>
+#include <climits>
+
+// Builds may lower the limit to exercise the split paths on small inputs
+#ifndef MAX_MESSAGE_ELEMENTS
+#define MAX_MESSAGE_ELEMENTS INT_MAX
+#endif
+
+namespace {
+
+std::vector<int> to_int(const std::vector<long long>& values) {
+    return std::vector<int>(values.begin(), values.end());
+}
+
+// Post nonblocking transfers of count elements in messages of at most
+// max_message_elements(); MPI keeps their order on one (peer, tag)
+template <typename T>
+void post_split(bool send, T* buffer, long long count, int peer, int tag,
+                MPI_Comm comm, std::vector<MPI_Request>& requests) {
+    MPI_Datatype type = mpi_type<T>();
+    long long limit = static_cast<long long>(max_message_elements());
+    for (long long first = 0; first < count; first += limit) {
+        int length = static_cast<int>(std::min(limit, count - first));
+        requests.emplace_back();
+        if (send) {
+            MPI_Isend(buffer + first, length, type, peer, tag, comm, &requests.back());
+        } else {
+            MPI_Irecv(buffer + first, length, type, peer, tag, comm, &requests.back());
+        }
+    }
+}
+
+} // namespace
+
+size_t max_message_elements() {
+    return MAX_MESSAGE_ELEMENTS;
+}
+
+bool counts_fit_int(const std::vector<long long>& send_counts,
+                    const std::vector<long long>& send_displs,
+                    const std::vector<long long>& recv_counts,
+                    const std::vector<long long>& recv_displs,
+                    MPI_Comm comm) {
+    long long limit = static_cast<long long>(max_message_elements());
+    int local_fit = 1;
+    for (size_t r = 0; r < send_counts.size(); ++r) {
+        if (send_displs[r] + send_counts[r] > limit || recv_displs[r] + recv_counts[r] > limit) {
+            local_fit = 0;
+        }
+    }
+    int fit = 0;
+    MPI_Allreduce(&local_fit, &fit, 1, MPI_INT, MPI_LAND, comm);
+    return fit == 1;
+}
+
+template <typename T>
+void large_alltoallv(const T* send_buffer,
+                     const std::vector<long long>& send_counts,
+                     const std::vector<long long>& send_displs,
+                     T* recv_buffer,
+                     const std::vector<long long>& recv_counts,
+                     const std::vector<long long>& recv_displs,
+                     MPI_Comm comm) {
+    MPI_Datatype type = mpi_type<T>();
+#if MPI_VERSION >= 4
+    if (max_message_elements() == INT_MAX) {
+        std::vector<MPI_Count> sc(send_counts.begin(), send_counts.end());
+        std::vector<MPI_Aint> sd(send_displs.begin(), send_displs.end());
+        std::vector<MPI_Count> rc(recv_counts.begin(), recv_counts.end());
+        std::vector<MPI_Aint> rd(recv_displs.begin(), recv_displs.end());
+        MPI_Alltoallv_c(send_buffer, sc.data(), sd.data(), type,
+                        recv_buffer, rc.data(), rd.data(), type, comm);
+        return;
+    }
+#endif
+    if (counts_fit_int(send_counts, send_displs, recv_counts, recv_displs, comm)) {
+        std::vector<int> sc = to_int(send_counts);
+        std::vector<int> sd = to_int(send_displs);
+        std::vector<int> rc = to_int(recv_counts);
+        std::vector<int> rd = to_int(recv_displs);
+        MPI_Alltoallv(send_buffer, sc.data(), sd.data(), type,
+                      recv_buffer, rc.data(), rd.data(), type, comm);
+        return;
+    }
+    
+    // Pairwise transfers split into int-sized messages; the local run is
+    // copied directly
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    std::vector<MPI_Request> requests;
+    for (int r = 0; r < size; ++r) {
+        if (r == rank) continue;
+        post_split(false, recv_buffer + recv_displs[r], recv_counts[r], r, 0, comm, requests);
+    }
+    for (int r = 0; r < size; ++r) {
+        if (r == rank) continue;
+        post_split(true, const_cast<T*>(send_buffer) + send_displs[r], send_counts[r], r, 0,
+                   comm, requests);
+    }
+    std::copy(send_buffer + send_displs[rank], send_buffer + send_displs[rank] + send_counts[rank],
+              recv_buffer + recv_displs[rank]);
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+template <typename T>
+void large_sendrecv(const T* send_buffer, size_t send_count,
+                    T* recv_buffer, size_t recv_count,
+                    int partner, int tag, MPI_Comm comm) {
+    MPI_Datatype type = mpi_type<T>();
+#if MPI_VERSION >= 4
+    if (max_message_elements() == INT_MAX) {
+        MPI_Sendrecv_c(send_buffer, static_cast<MPI_Count>(send_count), type, partner, tag,
+                       recv_buffer, static_cast<MPI_Count>(recv_count), type, partner, tag,
+                       comm, MPI_STATUS_IGNORE);
+        return;
+    }
+#endif
+    // Both sides see the same two counts, so they agree on the rounds
+    size_t limit = max_message_elements();
+    size_t rounds = std::max<size_t>(1, (std::max(send_count, recv_count) + limit - 1) / limit);
+    for (size_t c = 0; c < rounds; ++c) {
+        size_t send_first = std::min(send_count, c * limit);
+        size_t recv_first = std::min(recv_count, c * limit);
+        int send_length = static_cast<int>(std::min(limit, send_count - send_first));
+        int recv_length = static_cast<int>(std::min(limit, recv_count - recv_first));
+        MPI_Sendrecv(send_buffer + send_first, send_length, type, partner, tag,
+                     recv_buffer + recv_first, recv_length, type, partner, tag,
+                     comm, MPI_STATUS_IGNORE);
+    }
+}
+
+#define INSTANTIATE_LARGE_COUNT(T) \
+    template void large_alltoallv<T>(const T*, const std::vector<long long>&, \
+                                     const std::vector<long long>&, T*, \
+                                     const std::vector<long long>&, \
+                                     const std::vector<long long>&, MPI_Comm); \
+    template void large_sendrecv<T>(const T*, size_t, T*, size_t, int, int, MPI_Comm);
+FOR_EACH_SORT_TYPE(INSTANTIATE_LARGE_COUNT)
+INSTANTIATE_LARGE_COUNT(FixedPayload<56>)
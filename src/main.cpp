@@ -5,31 +5,525 @@
 #include <cstring>
 #include <fstream>
 #include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <cmath>
+#include <memory>
+#include <unistd.h>
 
 #include "psrs_sort.h"
 #include "bitonic_sort.h"
+#include "distributed_radix_sort.h"
+#include "sort_plan.h"
+#include "selection.h"
+#include "autotune.h"
+#include "external_sort.h"
+#include "parallel_io.h"
+#include "hierarchical_exchange.h"
+#include "perf_counters.h"
+#include "memory_usage.h"
+#include "trace.h"
+#include "sort_types.h"
 #include "utils.h"
 
 void print_usage(const char* prog_name) {
-    std::cout << "Usage: " << prog_name << " <algorithm> <problem_size> <output_csv>\n\n"
+    std::cout << "Usage: " << prog_name << " <algorithm> <problem_size> <output_csv> [options]\n\n"
               << "Arguments:\n"
-              << "  algorithm      : psrs or bitonic\n"
-              << "  problem_size   : number of integers to sort\n"
+              << "  algorithm      : psrs, bitonic, radix (distributed MSD radix sort),\n"
+              << "                   auto (chosen by a startup probe) or select\n"
+              << "                   (quantiles or top-k without a full sort)\n"
+              << "  problem_size   : number of elements to sort\n"
               << "  output_csv     : output CSV file name\n\n"
+              << "Options:\n"
+              << "  --threads N    : worker threads per rank (hybrid MPI+threads, default 1)\n"
+              << "  --local-sort E : local sort engine: std or radix (default std)\n"
+              << "  --pipeline-chunk N : bitonic: overlap exchange and merge in chunks of N\n"
+              << "                   elements (default 0 = blocking exchange)\n"
+              << "  --key-type K   : int, int64, float or double (default int)\n"
+              << "  --payload P    : none, rowid (8-byte row ID) or record64 (64-byte\n"
+              << "                   record); payloads need --key-type int64 (default none)\n"
+              << "  --layout L     : aos or soa key+payload layout; soa is psrs only\n"
+              << "                   (default aos)\n"
+              << "  --distribution D : input keys: random, zipf, gaussian, equal, sorted,\n"
+              << "                   reverse, nearly-sorted or staggered (default random)\n"
+              << "  --splitters S  : psrs: regular, distributed or histogram splitter\n"
+              << "                   selection (default regular)\n"
+              << "  --oversample K : regular/distributed: K*p samples per rank (default 1)\n"
+              << "  --tolerance F  : histogram: allowed output imbalance as a fraction\n"
+              << "                   of n/p (default 0.01)\n"
+              << "  --rebalance    : psrs: move the output so each rank keeps its\n"
+              << "                   input count\n"
+              << "  --low-memory   : psrs: free the input after the exchange and merge in\n"
+              << "                   place: about 2x the input per rank instead of 3x\n"
+              << "  --exchange X   : flat, hierarchical (psrs, radix: via node leaders) or\n"
+              << "                   shared (single node: shared-memory window)\n"
+              << "                   exchange (default flat)\n"
+              << "  --external B   : psrs: out-of-core sort within B bytes of memory per\n"
+              << "                   rank (suffix K, M or G; random input only)\n"
+              << "  --spill-dir D  : external: directory for run files (default /tmp)\n"
+              << "  --input F      : sort the raw binary elements of file F (read with\n"
+              << "                   MPI-IO; problem_size is taken from the file)\n"
+              << "  --output F     : write the sorted elements to raw binary file F\n"
+              << "  --plan         : sort every run through one SortPlan: buffers are\n"
+              << "                   kept and psrs pivots reused across runs\n"
+              << "  --huge-pages   : plan: transparent huge pages for the scratch buffers\n"
+              << "  --incremental N : psrs: sort problem_size elements once (untimed), then\n"
+              << "                   time the insertion of a new N-element batch per run\n"
+              << "  --quantiles L  : select: comma-separated fractions of n to select\n"
+              << "                   (default 0.5, the median)\n"
+              << "  --top-k K      : select: the K largest elements instead of quantiles\n"
+              << "  --rebalance-threshold F : incremental: even out the resident array once\n"
+              << "                   the fullest rank holds F x the average (default 1.25)\n"
+              << "  --tune-cache D : auto: directory of cached probes, 'none' to always\n"
+              << "                   probe (default $XDG_CACHE_HOME/parallel_sort)\n"
+              << "  --retune       : auto: probe again and replace the cached probe\n"
+              << "  --iterations N : timed runs, each on freshly generated data (default 1)\n"
+              << "  --warmup N     : untimed runs before the timed ones (default 0)\n"
+              << "  --seed S       : base seed of the generated data (default 42)\n"
+              << "  --no-verify    : skip the sortedness check after each run\n"
+              << "  --perf         : count cycles, instructions, LLC, branch and dTLB\n"
+              << "                   misses per phase (Linux perf_event_open)\n"
+              << "  --trace F      : write every rank's phases and MPI calls to F as\n"
+              << "                   Chrome trace JSON\n"
+              << "  --trace-events N : trace buffer size per rank; older events are\n"
+              << "                   overwritten (default 1048576)\n\n"
               << "Example:\n"
               << "  mpirun -np 16 " << prog_name << " psrs 100000000 results_psrs_16.csv\n"
+              << "  mpirun -np 2 " << prog_name << " psrs 100000000 results_hybrid.csv --threads 6\n"
+              << "  mpirun -np 8 " << prog_name << " psrs 10000000 results_rec.csv --key-type int64 --payload record64\n"
+              << "  mpirun -np 4 " << prog_name << " bitonic 10000000 results_runs.csv --warmup 1 --iterations 10\n"
+              << "  mpirun -np 8 " << prog_name << " auto 100000000 results_auto.csv\n"
+              << "  mpirun -np 8 " << prog_name << " select 100000000 results_sel.csv --quantiles 0.5,0.99\n"
               << std::endl;
 }
 
+// Out-of-core variant: input, runs and output live in files under spill_dir
+template <typename T>
+bool run_benchmark_external(const BenchmarkConfig& bench, size_t local_size, int rank, int size,
+                            const SortConfig& sort_config, TimingData& timing) {
+    std::string tag = std::to_string(getpid()) + "_r" + std::to_string(rank);
+    std::string input_path = sort_config.spill_dir + "/psort_input_" + tag + ".bin";
+    std::string output_path = sort_config.spill_dir + "/psort_output_" + tag + ".bin";
+    
+    // Generate the input one run-sized chunk at a time
+    std::FILE* input = std::fopen(input_path.c_str(), "wb");
+    if (!input) {
+        std::cerr << "Rank " << rank << ": cannot create " << input_path << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    size_t chunk_size = run_elements<T>(sort_config);
+    std::vector<T> chunk;
+    for (size_t first = 0, c = 0; first < local_size; first += chunk_size, ++c) {
+        chunk.resize(std::min(chunk_size, local_size - first));
+        generate_random_data(chunk, bench.seed + rank + c * 7919, rank, first);
+        std::fwrite(chunk.data(), sizeof(T), chunk.size(), input);
+    }
+    std::fclose(input);
+    std::vector<T>().swap(chunk);
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    double start_total = MPI_Wtime();
+    timing.output_elements = external_sort<T>(input_path, output_path, rank, size,
+                                              MPI_COMM_WORLD, timing, sort_config);
+    double end_total = MPI_Wtime();
+    timing.total_time = end_total - start_total;
+    
+    bool is_correct = !bench.verify
+                   || verify_sorted_file<T>(output_path, rank, size, MPI_COMM_WORLD);
+    std::remove(input_path.c_str());
+    std::remove(output_path.c_str());
+    return is_correct;
+}
+
+// One plan per element type, kept across the runs of a launch (--plan)
+template <typename T>
+std::unique_ptr<SortPlan<T>>& benchmark_plan() {
+    static std::unique_ptr<SortPlan<T>> plan;
+    return plan;
+}
+
+// Plans hold a communicator, so they go before MPI_Finalize
+void release_plans() {
+#define RELEASE_PLAN(T) benchmark_plan<T>().reset();
+    FOR_EACH_SORT_TYPE(RELEASE_PLAN)
+#undef RELEASE_PLAN
+}
+
+// Sorted distributed array that --incremental runs insert into, kept
+// across the runs of a launch
+template <typename T>
+struct ResidentArray {
+    std::vector<T> data;
+    unsigned long long total;   // Global element count
+    bool built;
+    
+    ResidentArray() : total(0), built(false) {}
+};
+
+template <typename T>
+ResidentArray<T>& benchmark_resident() {
+    static ResidentArray<T> resident;
+    return resident;
+}
+
+// Incremental variant: the first run sorts the initial problem_size
+// elements untimed; every run then times the insertion of one new batch
+template <typename T>
+bool run_benchmark_incremental(const BenchmarkConfig& bench, size_t local_size,
+                               int rank, int size, const SortConfig& sort_config,
+                               TimingData& timing) {
+    ResidentArray<T>& resident = benchmark_resident<T>();
+    if (!resident.built) {
+        resident.data.resize(local_size);
+        generate_data(resident.data, bench.distribution, bench.seed + rank, MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_build = MPI_Wtime();
+        TimingData build_timing;
+        psrs_sort(resident.data, rank, size, MPI_COMM_WORLD, build_timing, sort_config);
+        double build_time = MPI_Wtime() - start_build;
+        resident.total = bench.total_size;
+        resident.built = true;
+        if (rank == 0) {
+            std::cout << "Resident array: " << bench.total_size << " elements sorted in "
+                      << build_time << " s (untimed)\n";
+        }
+    }
+    
+    size_t batch_size = bench.incremental_batch / size
+                      + (rank < static_cast<int>(bench.incremental_batch % size) ? 1 : 0);
+    std::vector<T> batch(batch_size);
+    generate_data(batch, bench.distribution, bench.seed + 7919u + rank, MPI_COMM_WORLD);
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    double start_total = MPI_Wtime();
+    psrs_insert_batch(resident.data, batch, rank, size, MPI_COMM_WORLD, timing, sort_config);
+    double end_total = MPI_Wtime();
+    timing.total_time = end_total - start_total;
+    timing.output_elements = resident.data.size();
+    resident.total += bench.incremental_batch;
+    
+    // Sorted, and no element lost or duplicated
+    if (!bench.verify) return true;
+    unsigned long long local_count = resident.data.size();
+    unsigned long long global_count = 0;
+    MPI_Allreduce(&local_count, &global_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    bool is_correct = verify_sorted(resident.data, rank, size, MPI_COMM_WORLD);
+    return is_correct && global_count == resident.total;
+}
+
+// Quantile keys of the last select run, as text for any key type
+std::vector<std::string>& selected_keys() {
+    static std::vector<std::string> keys;
+    return keys;
+}
+
+// Check selected elements against a full sort of the same data: the
+// quantiles must match the sorted elements at their ranks, and the top-k
+// shares must hold exactly k elements, none below the k-th largest key and
+// every key above it
+template <typename T>
+bool verify_selection(const std::vector<T>& data, const std::vector<T>& selected,
+                      const BenchmarkConfig& bench, int rank, int size) {
+    std::vector<T> sorted = data;
+    TimingData sort_timing;
+    psrs_sort(sorted, rank, size, MPI_COMM_WORLD, sort_timing);
+    long long local_count = sorted.size();
+    long long n = 0;
+    long long offset = 0;
+    MPI_Allreduce(&local_count, &n, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&local_count, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) offset = 0;
+    auto owns = [&](long long k) { return k >= offset && k < offset + local_count; };
+    auto equivalent = [](const T& a, const T& b) { return !(a < b) && !(b < a); };
+    
+    int ok = 1;
+    if (bench.top_k == 0) {
+        for (size_t i = 0; i < bench.quantiles.size() && n > 0; ++i) {
+            long long k = std::llround(bench.quantiles[i] * (n - 1));
+            if (owns(k) && !equivalent(sorted[k - offset], selected[i])) ok = 0;
+        }
+    } else if (n > 0) {
+        long long k = std::min<long long>(bench.top_k, n);
+        int owner = owns(n - k) ? rank : 0;
+        int root = 0;
+        MPI_Allreduce(&owner, &root, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        T threshold = owns(n - k) ? sorted[n - k - offset] : T();
+        MPI_Bcast(&threshold, 1, mpi_type<T>(), root, MPI_COMM_WORLD);
+        
+        // Selected count, selected above the threshold, data above it
+        long long local[3] = {static_cast<long long>(selected.size()), 0, 0};
+        for (size_t i = 0; i < selected.size(); ++i) {
+            if (selected[i] < threshold || (i > 0 && selected[i - 1] < selected[i])) ok = 0;
+            if (threshold < selected[i]) local[1]++;
+        }
+        for (const T& value : data) {
+            if (threshold < value) local[2]++;
+        }
+        long long global[3];
+        MPI_Allreduce(local, global, 3, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (global[0] != k || global[1] != global[2]) ok = 0;
+    }
+    int all_ok = 0;
+    MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    return all_ok == 1;
+}
+
+// Select variant: quantiles or the top k of the data, without sorting it
+template <typename T>
+bool run_benchmark_select(const BenchmarkConfig& bench, size_t local_size, size_t first_element,
+                          int rank, int size, TimingData& timing) {
+    std::vector<T> local_data(local_size);
+    if (!bench.input_file.empty()) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_read = MPI_Wtime();
+        bool read_ok = read_binary_input(bench.input_file, local_data, first_element, MPI_COMM_WORLD);
+        timing.read_time = MPI_Wtime() - start_read;
+        if (!read_ok) {
+            if (rank == 0) {
+                std::cerr << "Error: cannot read " << bench.input_file << std::endl;
+            }
+            return false;
+        }
+    } else {
+        generate_data(local_data, bench.distribution, bench.seed + rank, MPI_COMM_WORLD);
+    }
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    std::vector<T> selected;
+    double start_total = MPI_Wtime();
+    if (bench.top_k > 0) {
+        distributed_top_k(local_data, bench.top_k, MPI_COMM_WORLD, timing, selected);
+    } else {
+        distributed_quantiles(local_data, bench.quantiles, MPI_COMM_WORLD, timing, selected);
+    }
+    double end_total = MPI_Wtime();
+    timing.total_time = end_total - start_total;
+    timing.output_elements = selected.size();
+    
+    // Quantile keys for the report
+    std::vector<std::string>& keys = selected_keys();
+    keys.clear();
+    for (size_t i = 0; bench.top_k == 0 && i < selected.size(); ++i) {
+        keys.push_back(std::to_string(SortTraits<T>::key(selected[i])));
+    }
+    
+    return !bench.verify || verify_selection(local_data, selected, bench, rank, size);
+}
+
+// Generate, sort and verify one rank's share of elements of type T
+template <typename T>
+bool run_benchmark(const BenchmarkConfig& bench, size_t local_size, size_t first_element,
+                   int rank, int size, const SortConfig& sort_config,
+                   TimingData& timing) {
+    if (sort_config.memory_budget > 0) {
+        return run_benchmark_external<T>(bench, local_size, rank, size, sort_config, timing);
+    }
+    if (bench.incremental_batch > 0) {
+        return run_benchmark_incremental<T>(bench, local_size, rank, size, sort_config, timing);
+    }
+    if (bench.algorithm == "select") {
+        return run_benchmark_select<T>(bench, local_size, first_element, rank, size, timing);
+    }
+    
+    std::vector<T> local_data(local_size);
+    
+    if (!bench.input_file.empty()) {
+        // Read this rank's block of the input file
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_read = MPI_Wtime();
+        bool read_ok = read_binary_input(bench.input_file, local_data, first_element, MPI_COMM_WORLD);
+        timing.read_time = MPI_Wtime() - start_read;
+        if (!read_ok) {
+            if (rank == 0) {
+                std::cerr << "Error: cannot read " << bench.input_file << std::endl;
+            }
+            return false;
+        }
+    } else {
+        generate_data(local_data, bench.distribution, bench.seed + rank, MPI_COMM_WORLD);
+    }
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    double start_total = MPI_Wtime();
+    
+    // Run the selected algorithm, through the launch's plan if there is one
+    if (bench.use_plan) {
+        std::unique_ptr<SortPlan<T>>& plan = benchmark_plan<T>();
+        if (!plan) {
+            PlanOptions options;
+            options.huge_pages = bench.huge_pages;
+            SortAlgorithm algorithm = bench.algorithm == "bitonic" ? SortAlgorithm::Bitonic
+                                    : bench.algorithm == "radix" ? SortAlgorithm::Radix
+                                                                 : SortAlgorithm::Psrs;
+            plan.reset(new SortPlan<T>(MPI_COMM_WORLD, local_size, algorithm,
+                                       sort_config, options));
+            MPI_Barrier(MPI_COMM_WORLD);
+            start_total = MPI_Wtime();
+        }
+        plan->execute(local_data, timing);
+    } else if (bench.algorithm == "psrs") {
+        psrs_sort(local_data, rank, size, MPI_COMM_WORLD, timing, sort_config);
+    } else if (bench.algorithm == "bitonic") {
+        bitonic_sort(local_data, rank, size, MPI_COMM_WORLD, timing, sort_config);
+    } else if (bench.algorithm == "radix") {
+        distributed_radix_sort(local_data, rank, size, MPI_COMM_WORLD, timing, sort_config);
+    }
+    
+    double end_total = MPI_Wtime();
+    timing.total_time = end_total - start_total;
+    timing.output_elements = local_data.size();
+    
+    // Verify correctness
+    bool is_correct = !bench.verify || verify_sorted(local_data, rank, size, MPI_COMM_WORLD);
+    
+    // Write the globally sorted data back in rank order
+    if (!bench.sorted_output_file.empty()) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start_write = MPI_Wtime();
+        bool write_ok = write_binary_output(bench.sorted_output_file, local_data, MPI_COMM_WORLD);
+        timing.write_time = MPI_Wtime() - start_write;
+        if (!write_ok) {
+            if (rank == 0) {
+                std::cerr << "Error: cannot write " << bench.sorted_output_file << std::endl;
+            }
+            is_correct = false;
+        }
+    }
+    return is_correct;
+}
+
+// Struct-of-arrays variant: keys and payloads live in separate arrays
+template <typename K, typename P>
+bool run_benchmark_soa(const BenchmarkConfig& bench, size_t local_size,
+                       int rank, int size,
+                       const SortConfig& sort_config, TimingData& timing) {
+    std::vector<K> keys(local_size);
+    std::vector<P> payloads(local_size);
+    
+    generate_data(keys, bench.distribution, bench.seed + rank, MPI_COMM_WORLD);
+    generate_payloads(payloads, rank);
+    
+    MPI_Barrier(MPI_COMM_WORLD);
+    
+    double start_total = MPI_Wtime();
+    psrs_sort_soa(keys, payloads, rank, size, MPI_COMM_WORLD, timing, sort_config);
+    double end_total = MPI_Wtime();
+    timing.total_time = end_total - start_total;
+    timing.output_elements = keys.size();
+    
+    bool sizes_match = keys.size() == payloads.size();
+    return (!bench.verify || verify_sorted(keys, rank, size, MPI_COMM_WORLD)) && sizes_match;
+}
+
+// One row of hardware counters: the five events and instructions per cycle
+void print_counter_row(const std::string& label, const long long* values) {
+    std::cout << "  " << std::left << std::setw(18) << label << std::right;
+    for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+        std::cout << std::setw(15) << values[e];
+    }
+    double ipc = values[PERF_CYCLES] > 0
+               ? static_cast<double>(values[PERF_INSTRUCTIONS]) / values[PERF_CYCLES] : 0.0;
+    std::cout << std::setw(8) << std::fixed << std::setprecision(2) << ipc
+              << std::defaultfloat << std::setprecision(6) << "\n";
+}
+
+// Counters per phase summed over ranks, then per rank for small runs;
+// rank_counts holds every rank's three phases back to back
+void print_perf_counters(const TimingData& summary, const std::vector<long long>& rank_counts,
+                         int size) {
+    const char* phases[3] = {"local_sort", "comm", "merge"};
+    std::cout << "Hardware counters:\n  " << std::setw(18) << "";
+    for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+        std::cout << std::setw(15) << perf_event_name(e);
+    }
+    std::cout << std::setw(8) << "ipc" << "\n";
+    print_counter_row(std::string(phases[0]) + " (all)", summary.local_sort_counts.perf.values);
+    print_counter_row(std::string(phases[1]) + " (all)", summary.comm_counts.perf.values);
+    print_counter_row(std::string(phases[2]) + " (all)", summary.merge_counts.perf.values);
+    if (size > 32) return;
+    for (int r = 0; r < size; ++r) {
+        for (int phase = 0; phase < 3; ++phase) {
+            print_counter_row(std::string(phases[phase]) + " r" + std::to_string(r),
+                              &rank_counts[(r * 3 + phase) * NUM_PERF_EVENTS]);
+        }
+    }
+}
+
+// Peak RSS and heap, worst rank first, as MB and multiples of the input
+// per rank; rank_memory holds every rank's peak RSS and peak heap
+void print_memory(const TimingData& summary, const std::vector<unsigned long long>& rank_memory,
+                  bool rss_reset, double input_bytes, int size) {
+    auto megabytes = [](double bytes) { return bytes / (1024.0 * 1024.0); };
+    auto ratio = [&](double bytes) { return input_bytes > 0 ? bytes / input_bytes : 0.0; };
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Peak RSS (max):      " << megabytes(summary.peak_rss_bytes) << " MB ("
+              << std::setprecision(2) << ratio(summary.peak_rss_bytes) << "x input per rank"
+              << (rss_reset ? "" : ", since process start") << ")\n";
+    std::cout << std::setprecision(1);
+    std::cout << "Peak heap (max):     " << megabytes(summary.total_counts.peak_heap_bytes)
+              << " MB (" << std::setprecision(2) << ratio(summary.total_counts.peak_heap_bytes)
+              << "x input per rank)\n";
+    std::cout << std::setprecision(1);
+    const char* phases[3] = {"local_sort", "comm", "merge"};
+    const PhaseCounts* counts[3] = {&summary.local_sort_counts, &summary.comm_counts,
+                                    &summary.merge_counts};
+    std::cout << "Heap peak/allocated: ";
+    for (int phase = 0; phase < 3; ++phase) {
+        std::cout << (phase ? ", " : "") << phases[phase] << " "
+                  << megabytes(counts[phase]->peak_heap_bytes) << "/"
+                  << megabytes(counts[phase]->allocated_bytes) << " MB";
+    }
+    std::cout << " (max/all ranks)\n";
+    if (size <= 32) {
+        std::cout << "Peak RSS/heap per rank (MB):";
+        for (int r = 0; r < size; ++r) {
+            std::cout << " " << megabytes(rank_memory[2 * r]) << "/"
+                      << megabytes(rank_memory[2 * r + 1]);
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+// Bytes per element of the selected key type and payload
+size_t element_bytes(const std::string& key_type, const std::string& payload) {
+    if (payload == "rowid") return sizeof(RowIdRecord);
+    if (payload == "record64") return sizeof(Record64);
+    if (key_type == "int64") return sizeof(std::int64_t);
+    if (key_type == "float") return sizeof(float);
+    if (key_type == "double") return sizeof(double);
+    return sizeof(int);
+}
+
+// Probe and model for the selected element type
+TuningDecision tune_element_type(const BenchmarkConfig& bench, LocalSortEngine engine,
+                                 const TuningOptions& options) {
+    long long n = bench.total_size;
+    if (bench.payload == "rowid") return autotune<RowIdRecord>(n, MPI_COMM_WORLD, engine, options);
+    if (bench.payload == "record64") return autotune<Record64>(n, MPI_COMM_WORLD, engine, options);
+    if (bench.key_type == "int64") return autotune<std::int64_t>(n, MPI_COMM_WORLD, engine, options);
+    if (bench.key_type == "float") return autotune<float>(n, MPI_COMM_WORLD, engine, options);
+    if (bench.key_type == "double") return autotune<double>(n, MPI_COMM_WORLD, engine, options);
+    return autotune<int>(n, MPI_COMM_WORLD, engine, options);
+}
+
 int main(int argc, char* argv[]) {
-    MPI_Init(&argc, &argv);
+    // Worker threads only compute; MPI is called from the main thread
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     
     // Parse command line arguments
-    if (argc != 4) {
+    if (argc < 4) {
         if (rank == 0) {
             std::cerr << "Error: Invalid number of arguments\n\n";
             print_usage(argv[0]);
@@ -38,121 +532,660 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    std::string algorithm = argv[1];
-    size_t problem_size = std::stoull(argv[2]);
-    std::string output_file = argv[3];
+    BenchmarkConfig bench;
+    bench.algorithm = argv[1];
+    bench.tune_cache = default_tuning_cache_dir();
+    bench.total_size = std::stoull(argv[2]);
+    bench.output_file = argv[3];
+    
+    SortConfig sort_config;
+    for (int i = 4; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--threads" && i + 1 < argc) {
+            sort_config.threads_per_rank = std::atoi(argv[++i]);
+        } else if (option == "--pipeline-chunk" && i + 1 < argc) {
+            sort_config.pipeline_chunk = std::stoull(argv[++i]);
+        } else if (option == "--key-type" && i + 1 < argc) {
+            bench.key_type = argv[++i];
+        } else if (option == "--payload" && i + 1 < argc) {
+            bench.payload = argv[++i];
+        } else if (option == "--layout" && i + 1 < argc) {
+            bench.layout = argv[++i];
+        } else if (option == "--oversample" && i + 1 < argc) {
+            sort_config.oversampling = std::atoi(argv[++i]);
+        } else if (option == "--tolerance" && i + 1 < argc) {
+            sort_config.balance_tolerance = std::atof(argv[++i]);
+        } else if (option == "--iterations" && i + 1 < argc) {
+            bench.iterations = std::atoi(argv[++i]);
+        } else if (option == "--warmup" && i + 1 < argc) {
+            bench.warmup_iterations = std::atoi(argv[++i]);
+        } else if (option == "--seed" && i + 1 < argc) {
+            bench.seed = std::stoul(argv[++i]);
+        } else if (option == "--no-verify") {
+            bench.verify = false;
+        } else if (option == "--perf") {
+            bench.perf_counters = true;
+        } else if (option == "--trace" && i + 1 < argc) {
+            bench.trace_file = argv[++i];
+        } else if (option == "--trace-events" && i + 1 < argc) {
+            bench.trace_events = std::stoull(argv[++i]);
+        } else if (option == "--rebalance") {
+            sort_config.exact_rebalance = true;
+        } else if (option == "--low-memory") {
+            sort_config.low_memory = true;
+        } else if (option == "--plan") {
+            bench.use_plan = true;
+        } else if (option == "--huge-pages") {
+            bench.huge_pages = true;
+        } else if (option == "--incremental" && i + 1 < argc) {
+            bench.incremental_batch = std::stoull(argv[++i]);
+        } else if (option == "--tune-cache" && i + 1 < argc) {
+            bench.tune_cache = argv[++i];
+            if (bench.tune_cache == "none") bench.tune_cache.clear();
+        } else if (option == "--retune") {
+            bench.retune = true;
+        } else if (option == "--top-k" && i + 1 < argc) {
+            bench.top_k = std::stoll(argv[++i]);
+        } else if (option == "--quantiles" && i + 1 < argc) {
+            if (!parse_fraction_list(argv[++i], bench.quantiles)) {
+                if (rank == 0) {
+                    std::cerr << "Error: --quantiles needs comma-separated fractions in [0, 1]\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (option == "--rebalance-threshold" && i + 1 < argc) {
+            sort_config.rebalance_threshold = std::stod(argv[++i]);
+        } else if (option == "--input" && i + 1 < argc) {
+            bench.input_file = argv[++i];
+        } else if (option == "--output" && i + 1 < argc) {
+            bench.sorted_output_file = argv[++i];
+        } else if (option == "--spill-dir" && i + 1 < argc) {
+            sort_config.spill_dir = argv[++i];
+        } else if (option == "--external" && i + 1 < argc) {
+            if (!parse_byte_size(argv[++i], sort_config.memory_budget)
+                || sort_config.memory_budget == 0) {
+                if (rank == 0) {
+                    std::cerr << "Error: --external needs a positive byte count (e.g. 256M)\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (option == "--distribution" && i + 1 < argc) {
+            if (!parse_input_distribution(argv[++i], bench.distribution)) {
+                if (rank == 0) {
+                    std::cerr << "Error: Unknown input distribution '" << argv[i] << "'\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (option == "--splitters" && i + 1 < argc) {
+            if (!parse_splitter_method(argv[++i], sort_config.splitters)) {
+                if (rank == 0) {
+                    std::cerr << "Error: Splitter method must be 'regular', 'distributed' or 'histogram'\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (option == "--exchange" && i + 1 < argc) {
+            if (!parse_exchange_method(argv[++i], sort_config.exchange)) {
+                if (rank == 0) {
+                    std::cerr << "Error: Exchange must be 'flat', 'hierarchical' or 'shared'\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (option == "--local-sort" && i + 1 < argc) {
+            if (!parse_local_sort_engine(argv[++i], sort_config.local_sort)) {
+                if (rank == 0) {
+                    std::cerr << "Error: Local sort engine must be 'std' or 'radix'\n";
+                }
+                MPI_Finalize();
+                return 1;
+            }
+        } else {
+            if (rank == 0) {
+                std::cerr << "Error: Unknown or incomplete option '" << option << "'\n\n";
+                print_usage(argv[0]);
+            }
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    
+    if (sort_config.threads_per_rank < 1) {
+        if (rank == 0) {
+            std::cerr << "Error: --threads must be at least 1\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    if (bench.iterations < 1 || bench.warmup_iterations < 0) {
+        if (rank == 0) {
+            std::cerr << "Error: --iterations must be at least 1 and --warmup at least 0\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    if (provided < MPI_THREAD_FUNNELED && sort_config.threads_per_rank > 1 && rank == 0) {
+        std::cerr << "Warning: MPI library does not provide MPI_THREAD_FUNNELED\n";
+    }
+    
+    // auto becomes psrs or bitonic once the problem size is known; options
+    // only PSRS supports leave just its parameters to tune
+    TuningOptions tuning;
+    if (bench.algorithm == "auto") {
+        bench.auto_tune = true;
+        tuning.allow_bitonic = sort_config.splitters == SplitterMethod::Regular
+                            && !sort_config.exact_rebalance && !sort_config.low_memory
+                            && sort_config.exchange != ExchangeMethod::Hierarchical
+                            && sort_config.memory_budget == 0
+                            && bench.incremental_batch == 0 && bench.layout == "aos";
+        tuning.allow_pipeline = sort_config.exchange != ExchangeMethod::Shared;
+        tuning.reprobe = bench.retune;
+        tuning.cache_dir = bench.tune_cache;
+        bench.algorithm = "psrs";
+    } else if (bench.retune) {
+        if (rank == 0) {
+            std::cerr << "Error: --retune applies to auto\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
     
     // Validate algorithm
-    if (algorithm != "psrs" && algorithm != "bitonic") {
+    if (bench.algorithm != "psrs" && bench.algorithm != "bitonic" && bench.algorithm != "radix"
+        && bench.algorithm != "select") {
+        if (rank == 0) {
+            std::cerr << "Error: Algorithm must be 'psrs', 'bitonic', 'radix', 'auto' or 'select'\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    // Validate element type
+    std::string type_error;
+    if (bench.key_type != "int" && bench.key_type != "int64" && bench.key_type != "float" && bench.key_type != "double") {
+        type_error = "Key type must be 'int', 'int64', 'float' or 'double'";
+    } else if (bench.payload != "none" && bench.payload != "rowid" && bench.payload != "record64") {
+        type_error = "Payload must be 'none', 'rowid' or 'record64'";
+    } else if (bench.payload != "none" && bench.key_type != "int64") {
+        type_error = "Payloads require --key-type int64";
+    } else if (bench.layout != "aos" && bench.layout != "soa") {
+        type_error = "Layout must be 'aos' or 'soa'";
+    } else if (bench.layout == "soa" && (bench.payload == "none" || bench.algorithm != "psrs")) {
+        type_error = "The soa layout needs a payload and the psrs algorithm";
+    } else if (bench.algorithm != "psrs" && (sort_config.splitters != SplitterMethod::Regular
+                                             || sort_config.exact_rebalance)) {
+        type_error = "--splitters and --rebalance apply to psrs only";
+    } else if (sort_config.exchange == ExchangeMethod::Hierarchical
+               && bench.algorithm != "psrs" && bench.algorithm != "radix") {
+        type_error = "--exchange hierarchical applies to psrs and radix";
+    } else if (sort_config.exchange == ExchangeMethod::Shared && sort_config.pipeline_chunk > 0) {
+        type_error = "--pipeline-chunk needs a message-passing exchange";
+    } else if (sort_config.low_memory
+               && (bench.algorithm != "psrs" || bench.layout != "aos"
+                   || sort_config.exchange == ExchangeMethod::Shared
+                   || sort_config.memory_budget > 0)) {
+        type_error = "--low-memory needs psrs with the aos layout, a message-passing "
+                     "exchange and an in-memory sort";
+    } else if (bench.use_plan && (bench.layout != "aos" || sort_config.memory_budget > 0)) {
+        type_error = "--plan needs the aos layout and an in-memory sort";
+    } else if (bench.huge_pages && !bench.use_plan) {
+        type_error = "--huge-pages applies to --plan";
+    } else if (bench.incremental_batch > 0
+               && (bench.algorithm != "psrs" || bench.layout != "aos" || bench.use_plan
+                   || sort_config.memory_budget > 0 || sort_config.exchange == ExchangeMethod::Shared
+                   || !bench.input_file.empty() || !bench.sorted_output_file.empty())) {
+        type_error = "--incremental needs psrs with the aos layout, a message-passing "
+                     "exchange, an in-memory sort and generated data (no --plan, --input "
+                     "or --output)";
+    } else if (bench.algorithm == "select"
+               && (bench.layout != "aos" || bench.use_plan || bench.incremental_batch > 0
+                   || sort_config.memory_budget > 0 || !bench.sorted_output_file.empty())) {
+        type_error = "select needs the aos layout and an in-memory run (no --plan, "
+                     "--incremental, --external or --output)";
+    } else if ((bench.top_k != 0 || !bench.quantiles.empty()) && bench.algorithm != "select") {
+        type_error = "--quantiles and --top-k apply to select";
+    } else if (bench.top_k < 0 || (bench.top_k > 0 && !bench.quantiles.empty())) {
+        type_error = "--top-k must be positive and cannot be combined with --quantiles";
+    } else if (sort_config.rebalance_threshold < 1) {
+        type_error = "--rebalance-threshold must be at least 1";
+    } else if (sort_config.oversampling < 1) {
+        type_error = "--oversample must be at least 1";
+    } else if (sort_config.balance_tolerance < 0) {
+        type_error = "--tolerance must not be negative";
+    } else if (sort_config.memory_budget > 0
+               && (bench.algorithm != "psrs" || bench.layout != "aos"
+                   || bench.distribution != InputDistribution::Random
+                   || sort_config.splitters != SplitterMethod::Regular
+                   || sort_config.exact_rebalance
+                   || sort_config.exchange != ExchangeMethod::Flat)) {
+        type_error = "--external supports psrs with regular splitters, the flat exchange, "
+                     "the aos layout and random input";
+    } else if ((!bench.input_file.empty() || !bench.sorted_output_file.empty())
+               && (bench.layout != "aos" || sort_config.memory_budget > 0)) {
+        type_error = "--input and --output need the aos layout and an in-memory sort";
+    }
+    if (!type_error.empty()) {
+        if (rank == 0) {
+            std::cerr << "Error: " << type_error << "\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    
+    // Select defaults to the median
+    if (bench.algorithm == "select" && bench.top_k == 0 && bench.quantiles.empty()) {
+        bench.quantiles.push_back(0.5);
+    }
+    
+    // The input file determines the problem size
+    if (!bench.input_file.empty()) {
+        MPI_Offset file_bytes = binary_file_size(bench.input_file, MPI_COMM_WORLD);
+        size_t elem_bytes = element_bytes(bench.key_type, bench.payload);
+        if (file_bytes < 0 || file_bytes % elem_bytes != 0) {
+            if (rank == 0) {
+                std::cerr << "Error: cannot open " << bench.input_file << " or its size is not a "
+                          << "multiple of the " << elem_bytes << "-byte element\n";
+            }
+            MPI_Finalize();
+            return 1;
+        }
+        bench.total_size = file_bytes / elem_bytes;
+    }
+    
+    // Shared-memory nodes the hierarchical exchange aggregates over; the
+    // shared exchange needs them all on one
+    int num_nodes = 0;
+    if (sort_config.exchange != ExchangeMethod::Flat) {
+        num_nodes = shared_memory_nodes(MPI_COMM_WORLD);
+    }
+    if (sort_config.exchange == ExchangeMethod::Shared && num_nodes > 1) {
         if (rank == 0) {
-            std::cerr << "Error: Algorithm must be 'psrs' or 'bitonic'\n";
+            std::cerr << "Error: --exchange shared needs every rank on one node (found "
+                      << num_nodes << ")\n";
         }
         MPI_Finalize();
         return 1;
     }
     
+    // Hardware counters must be open before the thread pool starts
+    int perf_events = 0;
+    if (bench.perf_counters) {
+        int opened = perf_counters_open();
+        MPI_Allreduce(&opened, &perf_events, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    }
+    
+    // Startup probe (or its cached result) and the cost model; the
+    // probe's thread pool starts after the counters are open
+    TuningDecision decision;
+    if (bench.auto_tune) {
+        decision = tune_element_type(bench, sort_config.local_sort, tuning);
+        apply_decision(decision, sort_config);
+        bench.algorithm = decision.algorithm == SortAlgorithm::Bitonic ? "bitonic" : "psrs";
+    }
+    
     // Print configuration (rank 0 only)
     if (rank == 0) {
         std::cout << "Parallel Sorting Benchmark\n";
         std::cout << "==========================\n";
-        std::cout << "Algorithm:     " << algorithm << "\n";
-        std::cout << "Problem size:  " << problem_size << "\n";
+        std::cout << "Algorithm:     " << bench.algorithm << "\n";
+        if (bench.auto_tune) {
+            const MachineProfile& profile = decision.profile;
+            std::cout << "Auto-tuned:    ";
+            if (decision.from_cache) {
+                std::cout << "cached probe";
+            } else {
+                std::cout << "probe took " << decision.probe_time << " s";
+            }
+            std::cout << "; model: psrs " << decision.psrs_estimate << " s";
+            if (tuning.allow_bitonic) {
+                std::cout << ", bitonic " << decision.bitonic_estimate << " s";
+            }
+            std::cout << "\n";
+            std::cout << "Probe:         alpha " << profile.latency * 1e6 << " us, beta "
+                      << profile.byte_time * 1e9 << " ns/byte, sort "
+                      << profile.sort_time * 1e9 << " ns/elem/level, merge "
+                      << profile.merge_time * 1e9 << " ns/elem, " << profile.cores_per_rank
+                      << " cores/rank (" << profile.thread_speedup << "x)\n";
+        }
+        std::cout << "Problem size:  " << bench.total_size << "\n";
         std::cout << "MPI ranks:     " << size << "\n";
-        std::cout << "Output file:   " << output_file << "\n";
+        std::cout << "Threads/rank:  " << sort_config.threads_per_rank << "\n";
+        std::cout << "Local sort:    " << local_sort_engine_name(sort_config.local_sort) << "\n";
+        if (sort_config.pipeline_chunk > 0) {
+            std::cout << "Pipeline chunk: " << sort_config.pipeline_chunk << "\n";
+        }
+        if (bench.algorithm == "psrs") {
+            std::cout << "Splitters:     " << splitter_method_name(sort_config.splitters);
+            if (sort_config.splitters == SplitterMethod::Histogram) {
+                std::cout << " (tolerance " << sort_config.balance_tolerance << ")";
+            } else {
+                std::cout << " (" << sort_config.oversampling << "p samples per rank)";
+            }
+            std::cout << (sort_config.exact_rebalance ? ", exact rebalance" : "") << "\n";
+            if (sort_config.low_memory) {
+                std::cout << "Memory:        low (input freed after exchange, in-place merge)\n";
+            }
+        }
+        std::cout << "Exchange:      " << exchange_method_name(sort_config.exchange);
+        if (sort_config.exchange == ExchangeMethod::Hierarchical) {
+            std::cout << " (" << num_nodes << " node" << (num_nodes == 1 ? "" : "s") << ")";
+        }
+        std::cout << "\n";
+        if (sort_config.memory_budget > 0) {
+            std::cout << "External sort: " << sort_config.memory_budget << " bytes/rank, spill to "
+                      << sort_config.spill_dir << "\n";
+        }
+        std::cout << "Key type:      " << bench.key_type << "\n";
+        if (!bench.input_file.empty()) {
+            std::cout << "Input file:    " << bench.input_file << "\n";
+        } else {
+            std::cout << "Distribution:  " << input_distribution_name(bench.distribution) << "\n";
+        }
+        if (!bench.sorted_output_file.empty()) {
+            std::cout << "Sorted output: " << bench.sorted_output_file << "\n";
+        }
+        if (bench.payload != "none") {
+            std::cout << "Payload:       " << bench.payload << " (" << bench.layout << ")\n";
+        }
+        std::cout << "Runs:          " << bench.warmup_iterations << " warmup + "
+                  << bench.iterations << " timed (seed " << bench.seed << ")"
+                  << (bench.verify ? "" : ", verification off") << "\n";
+        if (bench.perf_counters) {
+            std::cout << "Counters:      ";
+            if (perf_events == 0) {
+                std::cout << "unavailable (no PMU access), reported as 0";
+            }
+            for (int e = 0, listed = 0; perf_events > 0 && e < NUM_PERF_EVENTS; ++e) {
+                if (!perf_event_available(e)) continue;
+                std::cout << (listed++ ? ", " : "") << perf_event_name(e);
+            }
+            std::cout << "\n";
+        }
+        if (bench.algorithm == "select") {
+            std::cout << "Selection:     ";
+            if (bench.top_k > 0) {
+                std::cout << "top " << bench.top_k;
+            } else {
+                std::cout << "quantiles";
+                for (double q : bench.quantiles) std::cout << " " << q;
+            }
+            std::cout << "\n";
+        }
+        if (bench.incremental_batch > 0) {
+            std::cout << "Incremental:   " << bench.incremental_batch << " elements per run, "
+                      << "rebalance past " << sort_config.rebalance_threshold << "x n/p\n";
+        }
+        if (bench.use_plan) {
+            std::cout << "Plan:          kept across runs"
+                      << (bench.huge_pages ? ", huge pages" : "") << "\n";
+        }
+        if (!bench.trace_file.empty()) {
+            std::cout << "Trace:         " << bench.trace_file << " ("
+                      << bench.trace_events << " events per rank)\n";
+        }
+        std::cout << "Output file:   " << bench.output_file << "\n";
         std::cout << "==========================\n" << std::endl;
     }
     
     // Calculate local data size for each rank
-    size_t base_local_size = problem_size / size;
-    size_t remainder = problem_size % size;
+    size_t base_local_size = bench.total_size / size;
+    size_t remainder = bench.total_size % size;
     size_t local_size = base_local_size + (rank < static_cast<int>(remainder) ? 1 : 0);
+    size_t first_element = rank * base_local_size + std::min<size_t>(rank, remainder);
     
-    // Generate random data
-    std::vector<int> local_data(local_size);
+    // One run of the selected algorithm on the selected element type
+    auto run_once = [&](const BenchmarkConfig& run, TimingData& timing) {
+        if (run.layout == "soa") {
+            if (run.payload == "rowid") {
+                return run_benchmark_soa<std::int64_t, std::int64_t>(
+                    run, local_size, rank, size, sort_config, timing);
+            }
+            return run_benchmark_soa<std::int64_t, FixedPayload<56>>(
+                run, local_size, rank, size, sort_config, timing);
+        } else if (run.payload == "rowid") {
+            return run_benchmark<RowIdRecord>(run, local_size, first_element, rank, size,
+                                              sort_config, timing);
+        } else if (run.payload == "record64") {
+            return run_benchmark<Record64>(run, local_size, first_element, rank, size,
+                                           sort_config, timing);
+        } else if (run.key_type == "int64") {
+            return run_benchmark<std::int64_t>(run, local_size, first_element, rank, size,
+                                               sort_config, timing);
+        } else if (run.key_type == "float") {
+            return run_benchmark<float>(run, local_size, first_element, rank, size,
+                                        sort_config, timing);
+        } else if (run.key_type == "double") {
+            return run_benchmark<double>(run, local_size, first_element, rank, size,
+                                         sort_config, timing);
+        }
+        return run_benchmark<int>(run, local_size, first_element, rank, size,
+                                  sort_config, timing);
+    };
     
-    if (rank == 0) {
-        std::cout << "Generating random data..." << std::flush;
+    if (!bench.trace_file.empty()) {
+        trace_start(bench.trace_events, MPI_COMM_WORLD);
     }
     
-    generate_random_data(local_data, 42 + rank, rank);
+    // Warmup runs, then timed runs; each regenerates its input from its own
+    // seed, and only the last timed run writes the sorted output
+    int total_runs = bench.warmup_iterations + bench.iterations;
+    std::vector<TimingData> runs;
+    std::vector<TimingData> summaries;
+    bool is_correct = true;
+    bool rss_resets = true;     // Otherwise peak RSS covers the whole process so far
     
-    MPI_Barrier(MPI_COMM_WORLD);
+    for (int r = 0; r < total_runs; ++r) {
+        bool warmup = r < bench.warmup_iterations;
+        int iteration = r - bench.warmup_iterations;
+        BenchmarkConfig run = bench;
+        run.seed = bench.seed + r * 1000003u;
+        if (r + 1 < total_runs) {
+            run.sorted_output_file.clear();
+        }
+        
+        TimingData timing;
+        rss_resets = reset_peak_rss() && rss_resets;
+        double run_start = MPI_Wtime();
+        bool correct = run_once(run, timing);
+        timing.peak_rss_bytes = peak_rss_bytes();
+        if (trace_enabled()) {
+            trace_record(warmup ? "warmup" : "run", "run", run_start, MPI_Wtime(),
+                         warmup ? r : iteration);
+        }
+        TimingData summary = reduce_timing(timing, MPI_COMM_WORLD);
+        is_correct = is_correct && correct;
+        
+        if (rank == 0) {
+            if (warmup) {
+                std::cout << "Warmup " << (r + 1) << "/" << bench.warmup_iterations;
+            } else {
+                std::cout << "Run " << (iteration + 1) << "/" << bench.iterations;
+            }
+            std::cout << ": " << summary.total_time << " s"
+                      << (!bench.verify ? "" : (correct ? ", PASSED" : ", FAILED"))
+                      << (summary.splitters_reused ? ", pivots reused" : "")
+                      << (summary.rebalanced ? ", rebalanced" : "") << "\n";
+        }
+        if (warmup) continue;
+        
+        runs.push_back(timing);
+        summaries.push_back(summary);
+        write_results_csv(bench.output_file, bench, sort_config, summary, rank, size,
+                          iteration, correct);
+    }
     if (rank == 0) {
-        std::cout << " Done\n" << std::endl;
+        std::cout << std::endl;
     }
     
-    // Timing variables
-    TimingData timing;
-    double start_total = MPI_Wtime();
-    
-    // Run the selected algorithm
-    if (algorithm == "psrs") {
-        psrs_sort(local_data, rank, size, MPI_COMM_WORLD, timing);
-    } else if (algorithm == "bitonic") {
-        bitonic_sort(local_data, rank, size, MPI_COMM_WORLD, timing);
+    // Report the median timed run in detail
+    int median_run = 0;
+    if (rank == 0) {
+        std::vector<int> order(bench.iterations);
+        for (int i = 0; i < bench.iterations; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return summaries[a].total_time < summaries[b].total_time;
+        });
+        median_run = order[(bench.iterations - 1) / 2];
     }
+    MPI_Bcast(&median_run, 1, MPI_INT, 0, MPI_COMM_WORLD);
     
-    double end_total = MPI_Wtime();
-    timing.total_time = end_total - start_total;
+    // Per-rank output sizes: the largest one sets the merge and total time
+    unsigned long long local_output = runs[median_run].output_elements;
+    std::vector<unsigned long long> output_sizes(size);
+    MPI_Gather(&local_output, 1, MPI_UNSIGNED_LONG_LONG,
+               output_sizes.data(), 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
     
-    // Verify correctness
-    bool is_correct = verify_sorted(local_data, rank, size, MPI_COMM_WORLD);
-    
-    // Gather timing statistics
-    double global_total_time, global_local_sort, global_comm, global_merge;
-    double max_total_time, max_local_sort, max_comm, max_merge;
-    
-    MPI_Reduce(&timing.total_time, &global_total_time, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.local_sort_time, &global_local_sort, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.comm_time, &global_comm, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.merge_time, &global_merge, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    // Per-rank peak RSS and peak heap of the same run
+    unsigned long long local_memory[2] = {runs[median_run].peak_rss_bytes,
+                                          runs[median_run].total_counts.peak_heap_bytes};
+    std::vector<unsigned long long> rank_memory(2 * size);
+    MPI_Gather(local_memory, 2, MPI_UNSIGNED_LONG_LONG,
+               rank_memory.data(), 2, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+    int all_rss_reset = 0;
+    int local_rss_reset = rss_resets ? 1 : 0;
+    MPI_Reduce(&local_rss_reset, &all_rss_reset, 1, MPI_INT, MPI_LAND, 0, MPI_COMM_WORLD);
     
-    MPI_Reduce(&timing.total_time, &max_total_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.local_sort_time, &max_local_sort, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.comm_time, &max_comm, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&timing.merge_time, &max_merge, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    // Per-rank hardware counters of the same run
+    std::vector<long long> rank_counts;
+    if (bench.perf_counters) {
+        const TimingData& local = runs[median_run];
+        std::vector<long long> local_counts;
+        for (const PhaseCounts* counts : {&local.local_sort_counts, &local.comm_counts,
+                                          &local.merge_counts}) {
+            local_counts.insert(local_counts.end(), counts->perf.values,
+                                counts->perf.values + NUM_PERF_EVENTS);
+        }
+        rank_counts.resize(rank == 0 ? size * local_counts.size() : 0);
+        MPI_Gather(local_counts.data(), static_cast<int>(local_counts.size()), MPI_LONG_LONG,
+                   rank_counts.data(), static_cast<int>(local_counts.size()), MPI_LONG_LONG,
+                   0, MPI_COMM_WORLD);
+    }
     
     // Rank 0 outputs results
     if (rank == 0) {
-        double avg_total = global_total_time / size;
-        double avg_local_sort = global_local_sort / size;
-        double avg_comm = global_comm / size;
-        double avg_merge = global_merge / size;
+        const TimingData& summary = summaries[median_run];
         
-        std::cout << "Results:\n";
+        std::cout << "Results";
+        if (bench.iterations > 1) {
+            std::cout << " (median run, " << (median_run + 1) << "/" << bench.iterations << ")";
+        }
+        std::cout << ":\n";
         std::cout << "--------\n";
-        std::cout << "Verification:        " << (is_correct ? "PASSED" : "FAILED") << "\n";
-        std::cout << "Total time (max):    " << max_total_time << " s\n";
-        std::cout << "Local sort (avg):    " << avg_local_sort << " s\n";
-        std::cout << "Communication (avg): " << avg_comm << " s\n";
-        std::cout << "Merge time (avg):    " << avg_merge << " s\n";
-        std::cout << "Throughput:          " << (problem_size / max_total_time / 1e6) << " M elements/s\n";
-        std::cout << std::endl;
-        
-        // Write CSV output
-        std::ofstream csvfile;
-        bool file_exists = std::ifstream(output_file).good();
-        
-        csvfile.open(output_file, std::ios::app);
-        
-        // Write header if file doesn't exist
-        if (!file_exists) {
-            csvfile << "num_ranks,problem_size,total_time,local_sort_time,communication_time,merge_time\n";
+        if (bench.verify) {
+            std::cout << "Verification:        " << (is_correct ? "PASSED" : "FAILED") << "\n";
+        } else {
+            std::cout << "Verification:        skipped\n";
         }
+        std::cout << "Total time (max):    " << summary.total_time << " s\n";
+        std::cout << "Local sort (avg):    " << summary.local_sort_time << " s\n";
+        std::cout << "Communication (avg): " << summary.comm_time << " s\n";
+        std::cout << "Merge time (avg):    " << summary.merge_time << " s\n";
+        if (sort_config.pipeline_chunk > 0) {
+            double exchange_time = summary.overlap_time + summary.comm_time;
+            double hidden_pct = exchange_time > 0 ? 100.0 * summary.overlap_time / exchange_time : 0.0;
+            std::cout << "Comm hidden (avg):   " << summary.overlap_time << " s ("
+                      << hidden_pct << "% of exchange time)\n";
+        }
+        if (bench.algorithm == "bitonic" && (summary.padding_elements > 0 || summary.idle_steps > 0)) {
+            std::cout << "Padding (total):     " << summary.padding_elements << " virtual keys\n";
+            std::cout << "Idle steps (max):    " << summary.idle_steps
+                      << " (partner is a virtual rank)\n";
+        }
+        if (sort_config.memory_budget > 0) {
+            std::cout << "Spill I/O (avg):     " << summary.io_time << " s, "
+                      << summary.spill_bytes << " bytes written (all ranks)\n";
+        }
+        std::cout << "Bytes exchanged:     " << summary.bytes_exchanged << " (all ranks)\n";
         
-        // Write data
-        csvfile << size << "," 
-                << problem_size << "," 
-                << max_total_time << "," 
-                << avg_local_sort << "," 
-                << avg_comm << "," 
-                << avg_merge << "\n";
-        
-        csvfile.close();
-        
-        std::cout << "Results written to: " << output_file << std::endl;
+        unsigned long long min_output = output_sizes[0];
+        unsigned long long max_output = output_sizes[0];
+        for (unsigned long long n : output_sizes) {
+            min_output = std::min(min_output, n);
+            max_output = std::max(max_output, n);
+        }
+        unsigned long long resident_total = 0;
+        for (unsigned long long n : output_sizes) {
+            resident_total += n;
+        }
+        double ideal_output = static_cast<double>(bench.incremental_batch > 0
+                                                  ? resident_total : bench.total_size) / size;
+        double output_imbalance = ideal_output > 0 ? max_output / ideal_output : 1.0;
+        std::cout << "Output size (min/max): " << min_output << " / " << max_output
+                  << " (max is " << output_imbalance << "x n/p)\n";
+        if (size <= 32) {
+            std::cout << "Output per rank:    ";
+            for (unsigned long long n : output_sizes) {
+                std::cout << " " << n;
+            }
+            std::cout << "\n";
+        }
+        if (sort_config.splitters == SplitterMethod::Histogram) {
+            std::cout << "Splitter rounds:     " << summary.splitter_rounds << "\n";
+        }
+        if (bench.algorithm == "select") {
+            std::cout << "Narrowing rounds:    " << summary.splitter_rounds << "\n";
+            const std::vector<std::string>& keys = selected_keys();
+            for (size_t i = 0; i < keys.size(); ++i) {
+                std::cout << (i ? ", " : "Quantiles (last run): ") << bench.quantiles[i]
+                          << " = " << keys[i];
+            }
+            if (!keys.empty()) std::cout << "\n";
+        }
+        // Incremental runs: elements inserted, not the resident array
+        size_t run_elements = bench.incremental_batch > 0 ? bench.incremental_batch : bench.total_size;
+        std::cout << "Throughput:          " << (run_elements / summary.total_time / 1e6) << " M elements/s\n";
+        double data_mb = bench.total_size * element_bytes(bench.key_type, bench.payload) / 1e6;
+        if (!bench.input_file.empty()) {
+            std::cout << "Read (max):          " << summary.read_time << " s ("
+                      << (summary.read_time > 0 ? data_mb / summary.read_time : 0.0) << " MB/s)\n";
+        }
+        if (!bench.sorted_output_file.empty()) {
+            const TimingData& last = summaries.back();
+            std::cout << "Write (max):         " << last.write_time << " s ("
+                      << (last.write_time > 0 ? data_mb / last.write_time : 0.0) << " MB/s)\n";
+        }
+        double input_bytes = std::ceil(static_cast<double>(bench.total_size) / size)
+                           * element_bytes(bench.key_type, bench.payload);
+        print_memory(summary, rank_memory, all_rss_reset == 1, input_bytes, size);
+        if (perf_events > 0) {
+            print_perf_counters(summary, rank_counts, size);
+        }
+    }
+    
+    // Spread of the timed runs across runs and ranks
+    if (bench.iterations > 1) {
+        print_statistics(runs, rank, size, MPI_COMM_WORLD);
+    } else if (rank == 0) {
+        std::cout << std::endl;
+    }
+    
+    if (rank == 0) {
+        std::cout << "Results written to: " << bench.output_file << std::endl;
+    }
+    
+    if (!bench.trace_file.empty()) {
+        long long recorded = 0;
+        long long dropped = 0;
+        bool written = trace_write(bench.trace_file, MPI_COMM_WORLD, &recorded, &dropped);
+        if (rank == 0) {
+            if (written) {
+                std::cout << "Trace written to: " << bench.trace_file << " (" << recorded
+                          << " events";
+                if (dropped > 0) std::cout << ", " << dropped << " oldest overwritten";
+                std::cout << ")" << std::endl;
+            } else {
+                std::cerr << "Error: Cannot write trace file " << bench.trace_file << "\n";
+            }
+        }
     }
     
+    release_plans();
+    perf_counters_close();
     MPI_Finalize();
     return is_correct ? 0 : 1;
 }
@@ -0,0 +1,92 @@
+#include "memory_usage.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+    
+std::atomic<size_t> live_bytes(0);
+std::atomic<size_t> peak_bytes(0);
+std::atomic<size_t> allocated_bytes(0);
+    
+void raise_peak(size_t bytes) {
+    size_t peak = peak_bytes.load(std::memory_order_relaxed);
+    while (bytes > peak &&
+           !peak_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+    
+} // namespace
+
+void heap_record_allocation(size_t bytes) {
+    allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    raise_peak(live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void heap_record_free(size_t bytes) {
+    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t heap_live_bytes() {
+    return live_bytes.load(std::memory_order_relaxed);
+}
+
+size_t heap_peak_bytes() {
+    return peak_bytes.load(std::memory_order_relaxed);
+}
+
+size_t heap_allocated_bytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void heap_reset_peak() {
+    peak_bytes.store(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+size_t heap_begin_interval() {
+    size_t enclosing_peak = heap_peak_bytes();
+    heap_reset_peak();
+    return enclosing_peak;
+}
+
+size_t heap_end_interval(size_t enclosing_peak) {
+    size_t interval_peak = heap_peak_bytes();
+    raise_peak(enclosing_peak);
+    return interval_peak;
+}
+
+size_t peak_rss_bytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stoull(line.substr(6)) * 1024;     // Reported in kB
+        }
+    }
+    
+    // No procfs: ru_maxrss is in kB on Linux, but cannot be reset
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+void advise_huge_pages(void* data, size_t bytes) {
+    // madvise() wants page-aligned ranges: keep the whole pages inside
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = (reinterpret_cast<uintptr_t>(data) + page - 1) / page * page;
+    uintptr_t last = (reinterpret_cast<uintptr_t>(data) + bytes) / page * page;
+    if (last > first) {
+        madvise(reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE);
+    }
+}
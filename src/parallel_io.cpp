@@ -0,0 +1,112 @@
+#include "parallel_io.h"
+#include <algorithm>
+
+namespace {
+
+// Bytes moved per collective call
+constexpr size_t IO_CHUNK_BYTES = size_t(1) << 30;
+
+// Collective calls every rank must make to move count elements in chunks
+// of chunk elements
+int collective_rounds(size_t count, size_t chunk, MPI_Comm comm) {
+    int local_rounds = static_cast<int>((count + chunk - 1) / chunk);
+    int rounds = 0;
+    MPI_Allreduce(&local_rounds, &rounds, 1, MPI_INT, MPI_MAX, comm);
+    return rounds;
+}
+
+bool all_ok(int local_ok, MPI_Comm comm) {
+    int global_ok = 0;
+    MPI_Allreduce(&local_ok, &global_ok, 1, MPI_INT, MPI_LAND, comm);
+    return global_ok == 1;
+}
+
+} // namespace
+
+MPI_Offset binary_file_size(const std::string& path, MPI_Comm comm) {
+    MPI_File file;
+    if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        return -1;
+    }
+    MPI_Offset bytes = 0;
+    MPI_File_get_size(file, &bytes);
+    MPI_File_close(&file);
+    return bytes;
+}
+
+template <typename T>
+bool read_binary_input(const std::string& path, std::vector<T>& data,
+                       size_t first_element, MPI_Comm comm) {
+    MPI_File file;
+    if (MPI_File_open(comm, path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        return false;
+    }
+
+    MPI_Datatype type = mpi_type<T>();
+    size_t chunk = std::max<size_t>(1, IO_CHUNK_BYTES / sizeof(T));
+    int rounds = collective_rounds(data.size(), chunk, comm);
+    int local_ok = 1;
+
+    for (int r = 0; r < rounds; ++r) {
+        size_t first = std::min(data.size(), r * chunk);
+        size_t count = std::min(chunk, data.size() - first);
+        MPI_Offset offset = static_cast<MPI_Offset>((first_element + first) * sizeof(T));
+        MPI_Status status;
+        if (MPI_File_read_at_all(file, offset, data.data() + first, static_cast<int>(count),
+                                 type, &status) != MPI_SUCCESS) {
+            local_ok = 0;
+            continue;
+        }
+        int received = 0;
+        MPI_Get_count(&status, type, &received);
+        if (static_cast<size_t>(received) != count) local_ok = 0;
+    }
+
+    MPI_File_close(&file);
+    return all_ok(local_ok, comm);
+}
+
+template <typename T>
+bool write_binary_output(const std::string& path, const std::vector<T>& data,
+                         MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Offset of this rank's block: exclusive scan of the local sizes
+    unsigned long long local_count = data.size();
+    unsigned long long first_element = 0;
+    unsigned long long total = 0;
+    MPI_Exscan(&local_count, &first_element, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&local_count, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) first_element = 0;
+
+    MPI_File file;
+    if (MPI_File_open(comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        return false;
+    }
+    MPI_File_set_size(file, static_cast<MPI_Offset>(total * sizeof(T)));
+
+    MPI_Datatype type = mpi_type<T>();
+    size_t chunk = std::max<size_t>(1, IO_CHUNK_BYTES / sizeof(T));
+    int rounds = collective_rounds(data.size(), chunk, comm);
+    int local_ok = 1;
+
+    for (int r = 0; r < rounds; ++r) {
+        size_t first = std::min(data.size(), r * chunk);
+        size_t count = std::min(chunk, data.size() - first);
+        MPI_Offset offset = static_cast<MPI_Offset>((first_element + first) * sizeof(T));
+        if (MPI_File_write_at_all(file, offset, data.data() + first, static_cast<int>(count),
+                                  type, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+            local_ok = 0;
+        }
+    }
+
+    MPI_File_close(&file);
+    return all_ok(local_ok, comm);
+}
+
+#define INSTANTIATE_PARALLEL_IO(T) \
+    template bool read_binary_input<T>(const std::string&, std::vector<T>&, size_t, MPI_Comm); \
+    template bool write_binary_output<T>(const std::string&, const std::vector<T>&, MPI_Comm);
+FOR_EACH_SORT_TYPE(INSTANTIATE_PARALLEL_IO)
@@ -0,0 +1,108 @@
+#include "parallel_kernels.h"
+#include "radix_sort.h"
+#include <algorithm>
+
+template <typename T>
+size_t merge_path_split(const T* a, size_t na,
+                        const T* b, size_t nb,
+                        size_t k) {
+    size_t lo = k > nb ? k - nb : 0;
+    size_t hi = std::min(k, na);
+
+    // Binary search along the cross diagonal i + j = k
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (!(b[k - mid - 1] < a[mid])) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+template <typename T>
+void parallel_merge_range(const T* a, size_t na,
+                          const T* b, size_t nb,
+                          size_t out_begin, size_t out_count,
+                          T* out,
+                          ThreadPool& pool) {
+    int num_tasks = pool.size();
+    if (out_count < static_cast<size_t>(num_tasks) * 1024) {
+        num_tasks = 1;
+    }
+
+    pool.parallel_for(num_tasks, [&](int t) {
+        size_t first = out_begin + out_count * t / num_tasks;
+        size_t last = out_begin + out_count * (t + 1) / num_tasks;
+
+        size_t a_first = merge_path_split(a, na, b, nb, first);
+        size_t a_last = merge_path_split(a, na, b, nb, last);
+        size_t b_first = first - a_first;
+        size_t b_last = last - a_last;
+
+        std::merge(a + a_first, a + a_last,
+                   b + b_first, b + b_last,
+                   out + (first - out_begin));
+    });
+}
+
+template <typename T>
+void parallel_sort(std::vector<T>& data, ThreadPool& pool, LocalSortEngine engine) {
+    int num_chunks = pool.size();
+    if (num_chunks == 1 || data.size() < static_cast<size_t>(num_chunks) * 4096) {
+        if (engine == LocalSortEngine::Radix) {
+            radix_sort(data);
+        } else {
+            std::sort(data.begin(), data.end());
+        }
+        return;
+    }
+
+    // Sort one contiguous chunk per thread
+    std::vector<size_t> bounds(num_chunks + 1);
+    for (int i = 0; i <= num_chunks; ++i) {
+        bounds[i] = data.size() * i / num_chunks;
+    }
+
+    // The radix engine borrows the matching slice of the merge buffer
+    std::vector<T> buffer(data.size());
+    pool.parallel_for(num_chunks, [&](int i) {
+        if (engine == LocalSortEngine::Radix) {
+            radix_sort(data.data() + bounds[i], bounds[i + 1] - bounds[i],
+                       buffer.data() + bounds[i]);
+        } else {
+            std::sort(data.begin() + bounds[i], data.begin() + bounds[i + 1]);
+        }
+    });
+
+    // Merge neighbouring runs pairwise, each merge using the whole pool
+    std::vector<T>* src = &data;
+    std::vector<T>* dst = &buffer;
+
+    for (int width = 1; width < num_chunks; width *= 2) {
+        for (int i = 0; i < num_chunks; i += 2 * width) {
+            size_t left = bounds[i];
+            size_t mid = bounds[std::min(i + width, num_chunks)];
+            size_t right = bounds[std::min(i + 2 * width, num_chunks)];
+
+            parallel_merge_range(src->data() + left, mid - left,
+                                 src->data() + mid, right - mid,
+                                 0, right - left,
+                                 dst->data() + left,
+                                 pool);
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &data) {
+        data.swap(buffer);
+    }
+}
+
+#define INSTANTIATE_PARALLEL_KERNELS(T) \
+    template void parallel_sort<T>(std::vector<T>&, ThreadPool&, LocalSortEngine); \
+    template size_t merge_path_split<T>(const T*, size_t, const T*, size_t, size_t); \
+    template void parallel_merge_range<T>(const T*, size_t, const T*, size_t, \
+                                          size_t, size_t, T*, ThreadPool&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_PARALLEL_KERNELS)
@@ -0,0 +1,102 @@
+#include "perf_counters.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace {
+
+int event_fds[NUM_PERF_EVENTS] = {-1, -1, -1, -1, -1};
+bool counters_enabled = false;
+
+const char* const EVENT_NAMES[NUM_PERF_EVENTS] = {
+    "cycles", "instructions", "llc_misses", "branch_misses", "dtlb_misses"
+};
+
+void event_config(int event, perf_event_attr& attr) {
+    switch (event) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+    }
+}
+
+} // namespace
+
+int perf_counters_open() {
+    perf_counters_close();
+    int opened = 0;
+    for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        event_config(e, attr);
+        attr.exclude_kernel = 1;    // Allowed at perf_event_paranoid <= 2
+        attr.exclude_hv = 1;
+        attr.inherit = 1;           // Count threads created from now on
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        
+        // This process, any CPU, no group
+        event_fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (event_fds[e] >= 0) opened++;
+    }
+    counters_enabled = opened > 0;
+    return opened;
+}
+
+void perf_counters_close() {
+    for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+        if (event_fds[e] >= 0) close(event_fds[e]);
+        event_fds[e] = -1;
+    }
+    counters_enabled = false;
+}
+
+bool perf_counters_enabled() {
+    return counters_enabled;
+}
+
+bool perf_event_available(int event) {
+    return event_fds[event] >= 0;
+}
+
+PerfCounts perf_counters_read() {
+    PerfCounts counts;
+    for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+        if (event_fds[e] < 0) continue;
+        
+        // value, time enabled, time running
+        unsigned long long data[3] = {0, 0, 0};
+        if (read(event_fds[e], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) continue;
+        if (data[2] > 0 && data[2] < data[1]) {
+            counts.values[e] = static_cast<long long>(
+                static_cast<double>(data[0]) * data[1] / data[2]);
+        } else {
+            counts.values[e] = static_cast<long long>(data[0]);
+        }
+    }
+    return counts;
+}
+
+const char* perf_event_name(int event) {
+    return EVENT_NAMES[event];
+}
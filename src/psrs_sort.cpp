@@ -1,10 +1,15 @@
 #include "psrs_sort.h"
+#include "parallel_kernels.h"
+#include "splitters.h"
+#include "hierarchical_exchange.h"
+#include "shared_window.h"
+#include "bitonic_sort.h"
 #include <algorithm>
 #include <iostream>
-#include <queue>
 
-void select_regular_samples(const std::vector<int>& data,
-                           std::vector<int>& samples,
+template <typename T>
+void select_regular_samples(const std::vector<T>& data,
+                           std::vector<T>& samples,
                            int num_samples) {
     samples.clear();
     if (data.empty() || num_samples <= 0) return;
@@ -17,98 +22,373 @@ void select_regular_samples(const std::vector<int>& data,
     }
 }
 
-void partition_by_pivots(const std::vector<int>& data,
-                        const std::vector<int>& pivots,
-                        std::vector<std::vector<int>>& partitions) {
+template <typename T>
+void partition_by_pivots(const std::vector<T>& data,
+                        int rank,
+                        const std::vector<TaggedPivot<T>>& pivots,
+                        std::vector<long long>& send_counts,
+                        std::vector<long long>& send_displs) {
     int num_partitions = pivots.size() + 1;
-    partitions.clear();
-    partitions.resize(num_partitions);
+    send_counts.assign(num_partitions, 0);
+    send_displs.assign(num_partitions, 0);
     
-    for (int value : data) {
-        // Binary search to find which partition this value belongs to
-        auto it = std::lower_bound(pivots.begin(), pivots.end(), value);
-        int partition_idx = it - pivots.begin();
-        partitions[partition_idx].push_back(value);
+    // data is sorted, so partition k is the contiguous range of tagged
+    // elements (data[j], rank, j) in (pivots[k-1], pivots[k]]. Among keys
+    // equal to a pivot's, lower ranks go first and the pivot's own rank
+    // splits at the pivot's index. Each search starts where the last ended.
+    auto first = data.begin();
+    for (int k = 0; k < num_partitions; ++k) {
+        auto last = data.end();
+        if (k + 1 < num_partitions) {
+            const TaggedPivot<T>& pivot = pivots[k];
+            auto equal = std::equal_range(first, data.end(), pivot.value);
+            if (rank < pivot.rank) {
+                last = equal.second;
+            } else if (rank > pivot.rank) {
+                last = equal.first;
+            } else {
+                auto cut = data.begin() + std::min<long long>(pivot.index + 1, data.size());
+                last = std::min(std::max(cut, equal.first), equal.second);
+            }
+        }
+        send_displs[k] = first - data.begin();
+        send_counts[k] = last - first;
+        first = last;
     }
 }
 
-void merge_partitions(const std::vector<std::vector<int>>& partitions,
-                     std::vector<int>& result) {
-    result.clear();
+namespace {
+
+template <typename T>
+struct Run {
+    const T* begin;
+    const T* end;
+};
+
+// Up to this many runs a pairwise merge tree beats the loser tree
+constexpr size_t PAIRWISE_MERGE_MAX_RUNS = 4;
+
+/**
+ * Tournament (loser) tree over k sorted runs
+ *
+ * Internal node i holds the loser of the match played there and node 0 the
+ * overall winner, so each output element costs one leaf-to-root replay of
+ * log2(k) comparisons with no heap sift-down.
+ */
+template <typename T>
+class LoserTree {
+private:
+    int num_leaves;                 // k rounded up to a power of two
+    std::vector<int> nodes;
+    std::vector<const T*> heads;
+    std::vector<const T*> ends;
     
-    // Calculate total size
+    // Exhausted runs lose every match; ties go to the lower run index
+    bool beats(int a, int b) const {
+        if (heads[a] == ends[a]) return false;
+        if (heads[b] == ends[b]) return true;
+        if (*heads[a] < *heads[b]) return true;
+        return !(*heads[b] < *heads[a]) && a < b;
+    }
+    
+public:
+    explicit LoserTree(const std::vector<Run<T>>& runs) {
+        num_leaves = 1;
+        while (num_leaves < static_cast<int>(runs.size())) num_leaves *= 2;
+        
+        heads.resize(num_leaves, nullptr);
+        ends.resize(num_leaves, nullptr);
+        for (size_t i = 0; i < runs.size(); ++i) {
+            heads[i] = runs[i].begin;
+            ends[i] = runs[i].end;
+        }
+        
+        // Play the initial tournament bottom-up
+        nodes.resize(num_leaves);
+        std::vector<int> winners(2 * num_leaves);
+        for (int i = 0; i < num_leaves; ++i) {
+            winners[num_leaves + i] = i;
+        }
+        for (int n = num_leaves - 1; n >= 1; --n) {
+            int a = winners[2 * n];
+            int b = winners[2 * n + 1];
+            if (beats(a, b)) {
+                winners[n] = a;
+                nodes[n] = b;
+            } else {
+                winners[n] = b;
+                nodes[n] = a;
+            }
+        }
+        nodes[0] = winners[1];
+    }
+    
+    // Return the current minimum and replay its path to the root
+    const T* pop() {
+        int winner = nodes[0];
+        const T* element = heads[winner]++;
+        for (int n = (winner + num_leaves) / 2; n >= 1; n /= 2) {
+            if (beats(nodes[n], winner)) {
+                std::swap(nodes[n], winner);
+            }
+        }
+        nodes[0] = winner;
+        return element;
+    }
+};
+
+// Merge the runs into out, which must have room for all their elements
+template <typename T>
+void merge_runs(const std::vector<Run<T>>& runs, T* out) {
+    std::vector<Run<T>> nonempty;
     size_t total_size = 0;
-    for (const auto& partition : partitions) {
-        total_size += partition.size();
+    for (const auto& run : runs) {
+        if (run.begin != run.end) {
+            nonempty.push_back(run);
+            total_size += run.end - run.begin;
+        }
     }
-    result.reserve(total_size);
     
-    // Use k-way merge with priority queue
-    using PQElement = std::pair<int, std::pair<int, int>>; // <value, <partition_idx, element_idx>>
-    auto cmp = [](const PQElement& a, const PQElement& b) { return a.first > b.first; };
-    std::priority_queue<PQElement, std::vector<PQElement>, decltype(cmp)> pq(cmp);
+    if (nonempty.empty()) return;
     
-    // Initialize with first element from each partition
-    for (size_t i = 0; i < partitions.size(); ++i) {
-        if (!partitions[i].empty()) {
-            pq.push({partitions[i][0], {i, 0}});
+    if (nonempty.size() == 1) {
+        std::copy(nonempty[0].begin, nonempty[0].end, out);
+        return;
+    }
+    
+    if (nonempty.size() > PAIRWISE_MERGE_MAX_RUNS) {
+        LoserTree<T> tree(nonempty);
+        for (size_t i = 0; i < total_size; ++i) {
+            out[i] = *tree.pop();
         }
+        return;
     }
     
-    // Extract min and add next element from same partition
-    while (!pq.empty()) {
-        auto [value, indices] = pq.top();
-        pq.pop();
-        
-        result.push_back(value);
-        
-        int part_idx = indices.first;
-        int elem_idx = indices.second + 1;
-        
-        if (elem_idx < static_cast<int>(partitions[part_idx].size())) {
-            pq.push({partitions[part_idx][elem_idx], {part_idx, elem_idx}});
+    // Few runs: balanced tree of two-way merges, the last one writing to out
+    std::vector<T> scratch;
+    while (nonempty.size() > 2) {
+        size_t pair_size = 0;
+        for (size_t i = 0; i + 1 < nonempty.size(); i += 2) {
+            pair_size += (nonempty[i].end - nonempty[i].begin)
+                       + (nonempty[i + 1].end - nonempty[i + 1].begin);
+        }
+        std::vector<T> merged(pair_size);
+        std::vector<Run<T>> next;
+        T* dst = merged.data();
+        for (size_t i = 0; i < nonempty.size(); i += 2) {
+            if (i + 1 == nonempty.size()) {
+                next.push_back(nonempty[i]);
+                break;
+            }
+            T* dst_end = std::merge(nonempty[i].begin, nonempty[i].end,
+                                    nonempty[i + 1].begin, nonempty[i + 1].end, dst);
+            next.push_back({dst, dst_end});
+            dst = dst_end;
         }
+        scratch.swap(merged);
+        nonempty.swap(next);
     }
+    std::merge(nonempty[0].begin, nonempty[0].end,
+               nonempty[1].begin, nonempty[1].end, out);
 }
 
-void psrs_sort(std::vector<int>& local_data,
-               int rank,
-               int size,
-               MPI_Comm comm,
-               TimingData& timing) {
-    Timer total_timer, local_timer, comm_timer, merge_timer;
-    total_timer.start();
+// The received runs of buffer as pointer ranges
+template <typename T>
+std::vector<Run<T>> buffer_runs(const std::vector<T>& buffer,
+                                const std::vector<long long>& displs,
+                                const std::vector<long long>& counts) {
+    std::vector<Run<T>> runs;
+    for (size_t k = 0; k < counts.size(); ++k) {
+        const T* base = buffer.data() + displs[k];
+        runs.push_back({base, base + counts[k]});
+    }
+    return runs;
+}
+
+/**
+ * Split the runs into num_tasks disjoint key ranges
+ *
+ * Splitter values come from a length-proportional sample of the runs.
+ * bounds[t][k] is the start of task t's slice of run k and out_offsets[t]
+ * the start of its output.
+ */
+template <typename T>
+void split_runs(const std::vector<Run<T>>& runs,
+                size_t total_size,
+                int num_tasks,
+                std::vector<std::vector<size_t>>& bounds,
+                std::vector<size_t>& out_offsets) {
+    size_t num_runs = runs.size();
     
-    // Step 1: Local sort
-    local_timer.start();
-    std::sort(local_data.begin(), local_data.end());
-    timing.local_sort_time = local_timer.stop();
+    size_t stride = std::max<size_t>(1, total_size / (static_cast<size_t>(num_tasks) * 16));
+    std::vector<T> candidates;
+    for (size_t k = 0; k < num_runs; ++k) {
+        size_t count = runs[k].end - runs[k].begin;
+        for (size_t i = stride / 2; i < count; i += stride) {
+            candidates.push_back(runs[k].begin[i]);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
     
-    // Step 2: Regular sampling
-    int samples_per_rank = size;  // w = p
-    std::vector<int> local_samples;
-    select_regular_samples(local_data, local_samples, samples_per_rank);
+    bounds.assign(num_tasks + 1, std::vector<size_t>(num_runs, 0));
+    out_offsets.assign(num_tasks + 1, 0);
+    for (size_t k = 0; k < num_runs; ++k) {
+        bounds[num_tasks][k] = runs[k].end - runs[k].begin;
+    }
+    out_offsets[num_tasks] = total_size;
+    for (int t = 1; t < num_tasks; ++t) {
+        const T& splitter = candidates[candidates.size() * t / num_tasks];
+        for (size_t k = 0; k < num_runs; ++k) {
+            bounds[t][k] = std::lower_bound(runs[k].begin, runs[k].end, splitter) - runs[k].begin;
+            out_offsets[t] += bounds[t][k];
+        }
+    }
+}
+
+// Number of tasks a merge of total_size elements is worth splitting into
+inline int merge_task_count(size_t total_size, ThreadPool& pool) {
+    int num_tasks = pool.size();
+    if (total_size < static_cast<size_t>(num_tasks) * 4096) {
+        num_tasks = 1;
+    }
+    return num_tasks;
+}
+
+/**
+ * Steps 3-4 without a root: bitonic sort of the samples across ranks
+ *
+ * Every rank's sorted samples count as block samples, the missing ones
+ * virtual +inf padding, as in bitonic_sort(). Each compare-exchange sends
+ * the whole (small) block and keeps the lower or upper block of the merge.
+ * Afterwards global sample position j lies on rank j / block, so each rank
+ * picks the pivots in its slice and an MPI_Allgatherv, in rank order,
+ * hands every rank all p-1. Sample traffic per rank is
+ * O(block log^2 p) instead of the p * block samples gathered at the root.
+ */
+template <typename T>
+std::vector<TaggedPivot<T>> distributed_pivots(std::vector<TaggedPivot<T>>& samples,
+                                               size_t block,
+                                               int rank,
+                                               int size,
+                                               MPI_Comm comm) {
+    MPI_Datatype type = mpi_type<TaggedPivot<T>>();
+    long long local_count = samples.size();
+    long long total_samples = 0;
+    MPI_Allreduce(&local_count, &total_samples, 1, MPI_LONG_LONG, MPI_SUM, comm);
     
-    // Step 3: Gather all samples at root
-    comm_timer.start();
-    std::vector<int> all_samples;
-    if (rank == 0) {
-        all_samples.resize(size * samples_per_rank);
+    int num_stages = ceil_log2(size);
+    std::vector<TaggedPivot<T>> received(block);
+    std::vector<TaggedPivot<T>> merged;
+    for (int stage = 0; stage < num_stages; ++stage) {
+        for (int step = stage; step >= 0; --step) {
+            int partner_rank = network_partner(rank, stage, step);
+            if (partner_rank >= size) continue;
+            
+            MPI_Status status;
+            MPI_Sendrecv(samples.data(), static_cast<int>(samples.size()), type, partner_rank, 2,
+                         received.data(), static_cast<int>(block), type, partner_rank, 2,
+                         comm, &status);
+            int received_count = 0;
+            MPI_Get_count(&status, type, &received_count);
+            
+            merged.resize(samples.size() + received_count);
+            std::merge(samples.begin(), samples.end(),
+                       received.begin(), received.begin() + received_count,
+                       merged.begin());
+            size_t kept_low = std::min(block, merged.size());
+            if (rank < partner_rank) {
+                samples.assign(merged.begin(), merged.begin() + kept_low);
+            } else {
+                samples.assign(merged.begin() + kept_low, merged.end());
+            }
+        }
     }
     
-    // Pad local_samples if needed
-    while (local_samples.size() < static_cast<size_t>(samples_per_rank)) {
-        local_samples.push_back(local_samples.empty() ? 0 : local_samples.back());
+    // Pivot i is sample (i + 1) * total / p of the sorted sequence; every
+    // rank derives the same owner for each one
+    std::vector<TaggedPivot<T>> pivots(size - 1);
+    if (total_samples == 0) return pivots;
+    std::vector<int> pivot_counts(size, 0);
+    std::vector<int> pivot_displs(size, 0);
+    std::vector<TaggedPivot<T>> local_pivots;
+    for (int i = 0; i < size - 1; ++i) {
+        long long idx = std::min(total_samples - 1, (i + 1) * total_samples / size);
+        int owner = idx / block;
+        pivot_counts[owner]++;
+        if (owner == rank) {
+            local_pivots.push_back(samples[idx - rank * static_cast<long long>(block)]);
+        }
+    }
+    for (int r = 1; r < size; ++r) {
+        pivot_displs[r] = pivot_displs[r - 1] + pivot_counts[r - 1];
+    }
+    MPI_Allgatherv(local_pivots.data(), static_cast<int>(local_pivots.size()), type,
+                   pivots.data(), pivot_counts.data(), pivot_displs.data(), type, comm);
+    return pivots;
+}
+
+/**
+ * Steps 2-5: regular sampling, gather at root, pivot selection, broadcast
+ *
+ * Works on whatever the sorted elements are: whole records for the AoS
+ * layout, bare keys for SoA. SplitterMethod::Distributed replaces the root
+ * with distributed_pivots().
+ */
+template <typename T>
+std::vector<TaggedPivot<T>> select_pivots(const std::vector<T>& sorted_data,
+                             int rank,
+                             int size,
+                             MPI_Comm comm,
+                             TimingData& timing,
+                             const SortConfig& config) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    MPI_Datatype type = mpi_type<TaggedPivot<T>>();
+    
+    // Step 2: Regular sampling, each sample tagged with its position
+    int samples_per_rank = size * config.oversampling;  // w = k * p
+    std::vector<T> sample_values;
+    select_regular_samples(sorted_data, sample_values, samples_per_rank);
+    
+    size_t step = std::max<size_t>(1, sorted_data.size() / samples_per_rank);
+    std::vector<TaggedPivot<T>> local_samples(sample_values.size());
+    for (size_t i = 0; i < sample_values.size(); ++i) {
+        local_samples[i] = {sample_values[i], rank, static_cast<long long>(i * step)};
     }
     
-    MPI_Gather(local_samples.data(), samples_per_rank, MPI_INT,
-               all_samples.data(), samples_per_rank, MPI_INT,
-               0, comm);
+    if (config.splitters == SplitterMethod::Distributed) {
+        comm_timer.start();
+        std::vector<TaggedPivot<T>> pivots =
+            distributed_pivots(local_samples, samples_per_rank, rank, size, comm);
+        timing.comm_time += comm_timer.stop();
+        return pivots;
+    }
+    
+    // Step 3: Gather all samples at root; ranks with fewer than w elements
+    // contribute what they have rather than padding with duplicates
+    comm_timer.start();
+    int local_sample_count = local_samples.size();
+    std::vector<int> sample_counts(size);
+    std::vector<int> sample_displs(size);
+    MPI_Gather(&local_sample_count, 1, MPI_INT, sample_counts.data(), 1, MPI_INT, 0, comm);
+    
+    std::vector<TaggedPivot<T>> all_samples;
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; ++r) {
+            sample_displs[r] = total;
+            total += sample_counts[r];
+        }
+        all_samples.resize(total);
+    }
+    
+    MPI_Gatherv(local_samples.data(), local_sample_count, type,
+                all_samples.data(), sample_counts.data(), sample_displs.data(), type,
+                0, comm);
     timing.comm_time += comm_timer.stop();
     
     // Step 4: Select pivots at root
-    std::vector<int> pivots(size - 1);
-    if (rank == 0) {
+    std::vector<TaggedPivot<T>> pivots(size - 1);
+    if (rank == 0 && !all_samples.empty()) {
         std::sort(all_samples.begin(), all_samples.end());
         
         // Select p-1 pivots regularly from sorted samples
@@ -122,66 +402,689 @@ void psrs_sort(std::vector<int>& local_data,
     
     // Step 5: Broadcast pivots
     comm_timer.start();
-    MPI_Bcast(pivots.data(), size - 1, MPI_INT, 0, comm);
+    MPI_Bcast(pivots.data(), size - 1, type, 0, comm);
     timing.comm_time += comm_timer.stop();
     
-    // Step 6: Partition local data based on pivots
+    return pivots;
+}
+
+/**
+ * Steps 2-6: choose splitters and cut the sorted data into p partitions
+ *
+ * Regular sampling picks pivots at the root, distributed sampling across
+ * all ranks; histogram refinement places every boundary within
+ * config.balance_tolerance * n/p of i * n/p.
+ */
+template <typename T>
+void split_sorted_data(const std::vector<T>& sorted_data,
+                       int rank,
+                       int size,
+                       MPI_Comm comm,
+                       TimingData& timing,
+                       const SortConfig& config,
+                       std::vector<long long>& send_counts,
+                       std::vector<long long>& send_displs) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    
+    if (config.splitters == SplitterMethod::Histogram) {
+        comm_timer.start();
+        long long local_count = sorted_data.size();
+        long long total_count = 0;
+        MPI_Allreduce(&local_count, &total_count, 1, MPI_LONG_LONG, MPI_SUM, comm);
+        timing.comm_time += comm_timer.stop();
+        
+        std::vector<long long> targets(size - 1);
+        for (int i = 1; i < size; ++i) {
+            targets[i - 1] = total_count * i / size;
+        }
+        long long tolerance = static_cast<long long>(config.balance_tolerance * total_count / size);
+        
+        // Communication inside is added to comm_time; count the rest as partitioning
+        double comm_before = timing.comm_time;
+        PhaseCounts comm_counts_before = timing.comm_counts;
+        merge_timer.start();
+        timing.splitter_rounds = histogram_partition(sorted_data, targets, tolerance, comm,
+                                                     timing, send_counts, send_displs);
+        timing.merge_time += merge_timer.stop() - (timing.comm_time - comm_before);
+        timing.merge_counts.perf -= timing.comm_counts.perf;
+        timing.merge_counts.perf += comm_counts_before.perf;
+        timing.merge_counts.allocated_bytes -= timing.comm_counts.allocated_bytes
+                                             - comm_counts_before.allocated_bytes;
+        return;
+    }
+    
+    // Steps 2-5: Sample, pick and broadcast pivots
+    std::vector<TaggedPivot<T>> pivots = select_pivots(sorted_data, rank, size, comm, timing, config);
+    
+    // Step 6: Split the sorted local data at the pivots
     merge_timer.start();
-    std::vector<std::vector<int>> partitions;
-    partition_by_pivots(local_data, pivots, partitions);
+    partition_by_pivots(sorted_data, rank, pivots, send_counts, send_displs);
     timing.merge_time += merge_timer.stop();
+}
+
+// Exchange send counts and derive the receive layout; returns recv_total
+size_t exchange_counts(const std::vector<long long>& send_counts,
+                    std::vector<long long>& recv_counts,
+                    std::vector<long long>& recv_displs,
+                    MPI_Comm comm) {
+    int size = send_counts.size();
+    recv_counts.resize(size);
+    recv_displs.resize(size);
+    MPI_Alltoall(send_counts.data(), 1, MPI_LONG_LONG,
+                 recv_counts.data(), 1, MPI_LONG_LONG, comm);
     
-    // Step 7: Prepare for all-to-all exchange
-    std::vector<int> send_counts(size);
-    std::vector<int> send_displs(size);
-    std::vector<int> recv_counts(size);
-    std::vector<int> recv_displs(size);
-    
-    int send_offset = 0;
+    long long recv_total = 0;
     for (int i = 0; i < size; ++i) {
-        send_counts[i] = partitions[i].size();
-        send_displs[i] = send_offset;
-        send_offset += send_counts[i];
+        recv_displs[i] = recv_total;
+        recv_total += recv_counts[i];
+    }
+    return recv_total;
+}
+
+// Bytes this rank sends to other ranks for elements of elem_size bytes
+inline size_t remote_bytes(const std::vector<long long>& send_counts, int rank, size_t elem_size) {
+    size_t elements = 0;
+    for (size_t i = 0; i < send_counts.size(); ++i) {
+        if (static_cast<int>(i) != rank) elements += send_counts[i];
     }
+    return elements * elem_size;
+}
+
+// Largest output across ranks as a multiple of the average; collective
+double output_imbalance(size_t recv_total, size_t input_count, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    unsigned long long local_count[2] = {recv_total, input_count};
+    unsigned long long max_output = 0;
+    unsigned long long total_count = 0;
+    MPI_Allreduce(&local_count[0], &max_output, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+    MPI_Allreduce(&local_count[1], &total_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    double average = static_cast<double>(total_count) / size;
+    return average > 0 ? max_output / average : 1.0;
+}
+
+/**
+ * Send layout that moves a distributed sorted sequence, order preserved,
+ * so that this rank ends up with target_count elements
+ *
+ * Ranks own consecutive global ranges before and after; each rank sends
+ * the overlap of its current range with every rank's target range.
+ */
+void rebalance_layout(size_t local_count,
+                      size_t target_count,
+                      MPI_Comm comm,
+                      std::vector<long long>& send_counts,
+                      std::vector<long long>& send_displs) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    
+    long long local_counts[2] = {static_cast<long long>(local_count),
+                                 static_cast<long long>(target_count)};
+    std::vector<long long> all_counts(2 * size);
+    MPI_Allgather(local_counts, 2, MPI_LONG_LONG, all_counts.data(), 2, MPI_LONG_LONG, comm);
+    
+    long long begin = 0;
+    for (int r = 0; r < rank; ++r) {
+        begin += all_counts[2 * r];
+    }
+    long long end = begin + static_cast<long long>(local_count);
+    
+    send_counts.assign(size, 0);
+    send_displs.assign(size, 0);
+    long long target_begin = 0;
+    for (int r = 0; r < size; ++r) {
+        long long target_end = target_begin + all_counts[2 * r + 1];
+        long long first = std::max(begin, target_begin);
+        long long last = std::min(end, target_end);
+        send_displs[r] = std::min(std::max(first, begin), end) - begin;
+        send_counts[r] = std::max(0LL, last - first);
+        target_begin = target_end;
+    }
+}
+
+// Redistribute data with the given send layout; runs arrive in rank order
+template <typename T>
+void redistribute(std::vector<T>& data,
+                  const std::vector<long long>& send_counts,
+                  const std::vector<long long>& send_displs,
+                  MPI_Comm comm,
+                  ExchangeMethod method) {
+    std::vector<long long> recv_counts;
+    std::vector<long long> recv_displs;
+    size_t recv_total = exchange_counts(send_counts, recv_counts, recv_displs, comm);
+    
+    std::vector<T> result(recv_total);
+    alltoallv_exchange(data.data(), send_counts, send_displs,
+                       result.data(), recv_counts, recv_displs, comm, method);
+    data.swap(result);
+}
+
+} // namespace
+
+namespace {
+
+// Merge sorted runs, wherever they live, into result
+template <typename T>
+void merge_sorted_runs(const std::vector<Run<T>>& runs,
+                       std::vector<T>& result,
+                       ThreadPool& pool) {
+    size_t num_runs = runs.size();
     
-    // Flatten partitions for sending
-    std::vector<int> send_buffer;
-    send_buffer.reserve(local_data.size());
-    for (const auto& partition : partitions) {
-        send_buffer.insert(send_buffer.end(), partition.begin(), partition.end());
+    // Calculate total size
+    size_t total_size = 0;
+    for (const Run<T>& run : runs) {
+        total_size += run.end - run.begin;
     }
     
-    // Exchange counts
+    // result's contents are overwritten: grow it to the exact size without
+    // copying them over
+    if (result.capacity() < total_size) {
+        std::vector<T>().swap(result);
+        result.reserve(total_size);
+    }
+    result.resize(total_size);
+    
+    int num_tasks = merge_task_count(total_size, pool);
+    
+    if (num_tasks == 1) {
+        merge_runs(runs, result.data());
+        return;
+    }
+    
+    // Every thread merges a disjoint key range
+    std::vector<std::vector<size_t>> bounds;
+    std::vector<size_t> out_offsets;
+    split_runs(runs, total_size, num_tasks, bounds, out_offsets);
+    
+    pool.parallel_for(num_tasks, [&](int t) {
+        std::vector<Run<T>> slices;
+        for (size_t k = 0; k < num_runs; ++k) {
+            slices.push_back({runs[k].begin + bounds[t][k], runs[k].begin + bounds[t + 1][k]});
+        }
+        merge_runs(slices, result.data() + out_offsets[t]);
+    });
+}
+
+// Merge the adjacent sorted runs data[first, middle) and data[middle, last)
+// in place, through a copy of the shorter one; ties keep the first run's
+// elements first
+template <typename T>
+void merge_adjacent_runs(T* first, T* middle, T* last) {
+    if (first == middle || middle == last) return;
+    if (middle - first <= last - middle) {
+        std::vector<T> left(first, middle);
+        const T* i = left.data();
+        const T* i_end = i + left.size();
+        T* j = middle;
+        T* out = first;
+        while (i < i_end && j < last) {
+            *out++ = (*j < *i) ? *j++ : *i++;
+        }
+        std::copy(i, i_end, out);
+    } else {
+        std::vector<T> right(middle, last);
+        const T* j_begin = right.data();
+        const T* j = j_begin + right.size();
+        T* i = middle;
+        T* out = last;
+        while (j > j_begin && i > first) {
+            *--out = (*(j - 1) < *(i - 1)) ? *--i : *--j;
+        }
+        std::copy_backward(j_begin, j, out);
+    }
+}
+
+// Merge the runs of data[0, count) starting at displs (in order, back to
+// back) into one sorted run, pairwise in rounds; the pairs of a round run
+// in parallel and their copies take at most half of the data at once
+template <typename T>
+void merge_runs_in_place(T* data,
+                         size_t count,
+                         const std::vector<long long>& displs,
+                         ThreadPool& pool) {
+    std::vector<size_t> bounds(displs.begin(), displs.end());
+    bounds.push_back(count);
+    while (bounds.size() > 2) {
+        int pairs = (bounds.size() - 1) / 2;
+        pool.parallel_for(pairs, [&](int k) {
+            merge_adjacent_runs(data + bounds[2 * k], data + bounds[2 * k + 1],
+                                data + bounds[2 * k + 2]);
+        });
+        
+        std::vector<size_t> merged;
+        for (size_t i = 0; i < bounds.size(); i += 2) {
+            merged.push_back(bounds[i]);
+        }
+        if (merged.back() != count) merged.push_back(count);
+        bounds.swap(merged);
+    }
+}
+
+} // namespace
+
+template <typename T>
+void merge_partitions(const std::vector<T>& buffer,
+                     const std::vector<long long>& displs,
+                     const std::vector<long long>& counts,
+                     std::vector<T>& result,
+                     ThreadPool& pool) {
+    merge_sorted_runs(buffer_runs(buffer, displs, counts), result, pool);
+}
+
+template <typename K, typename P>
+void merge_partitions_soa(const std::vector<K>& key_buffer,
+                          const std::vector<P>& payload_buffer,
+                          const std::vector<long long>& displs,
+                          const std::vector<long long>& counts,
+                          std::vector<K>& keys,
+                          std::vector<P>& payloads,
+                          ThreadPool& pool) {
+    size_t num_runs = counts.size();
+    
+    size_t total_size = 0;
+    for (long long count : counts) {
+        total_size += count;
+    }
+    keys.resize(total_size);
+    payloads.resize(total_size);
+    
+    int num_tasks = merge_task_count(total_size, pool);
+    std::vector<std::vector<size_t>> bounds;
+    std::vector<size_t> out_offsets;
+    if (num_tasks == 1) {
+        bounds.assign(2, std::vector<size_t>(num_runs, 0));
+        for (size_t k = 0; k < num_runs; ++k) {
+            bounds[1][k] = counts[k];
+        }
+        out_offsets = {0, total_size};
+    } else {
+        split_runs(buffer_runs(key_buffer, displs, counts), total_size, num_tasks,
+                   bounds, out_offsets);
+    }
+    
+    // The tree compares keys only; each winner's position in key_buffer
+    // locates its payload
+    pool.parallel_for(num_tasks, [&](int t) {
+        std::vector<Run<K>> runs;
+        for (size_t k = 0; k < num_runs; ++k) {
+            const K* base = key_buffer.data() + displs[k];
+            runs.push_back({base + bounds[t][k], base + bounds[t + 1][k]});
+        }
+        LoserTree<K> tree(runs);
+        for (size_t i = out_offsets[t]; i < out_offsets[t + 1]; ++i) {
+            const K* winner = tree.pop();
+            keys[i] = *winner;
+            payloads[i] = payload_buffer[winner - key_buffer.data()];
+        }
+    });
+}
+
+template <typename T>
+void psrs_sort(std::vector<T>& local_data,
+               int rank,
+               int size,
+               MPI_Comm comm,
+               TimingData& timing,
+               const SortConfig& config) {
+    PsrsWorkspace<T> workspace;
+    psrs_sort(local_data, rank, size, comm, timing, config, workspace);
+}
+
+template <typename T>
+void psrs_sort(std::vector<T>& local_data,
+               int rank,
+               int size,
+               MPI_Comm comm,
+               TimingData& timing,
+               const SortConfig& config,
+               PsrsWorkspace<T>& workspace) {
+    Timer total_timer(&timing.total_counts, "psrs_sort");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+    
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
+    size_t input_count = local_data.size();
+    
+    // Step 1: Local sort
+    local_timer.start();
+    parallel_sort(local_data, pool, config.local_sort);
+    timing.local_sort_time = local_timer.stop();
+    
+    // Steps 2-6: Choose splitters and split the sorted local data; local_data
+    // itself is the send buffer, so nothing is copied
+    std::vector<long long>& send_counts = workspace.send_counts;
+    std::vector<long long>& send_displs = workspace.send_displs;
+    std::vector<long long>& recv_counts = workspace.recv_counts;
+    std::vector<long long>& recv_displs = workspace.recv_displs;
+    bool sampled = config.splitters != SplitterMethod::Histogram;
+    size_t recv_total = 0;
+    
+    // Warm start: split at the last call's pivots, and keep them if no rank
+    // would receive more than when they were chosen
+    workspace.reused = false;
+    if (workspace.reuse_splitters && sampled && !workspace.pivots.empty()) {
+        merge_timer.start();
+        partition_by_pivots(local_data, rank, workspace.pivots, send_counts, send_displs);
+        timing.merge_time += merge_timer.stop();
+        
+        comm_timer.start();
+        recv_total = exchange_counts(send_counts, recv_counts, recv_displs, comm);
+        double imbalance = output_imbalance(recv_total, input_count, comm);
+        timing.comm_time += comm_timer.stop();
+        workspace.reused = imbalance <= std::max(workspace.pivot_imbalance,
+                                                 1.0 + config.balance_tolerance);
+        timing.splitters_reused = workspace.reused ? 1 : 0;
+    }
+    
+    if (!workspace.reused) {
+        if (sampled) {
+            workspace.pivots = select_pivots(local_data, rank, size, comm, timing, config);
+            merge_timer.start();
+            partition_by_pivots(local_data, rank, workspace.pivots, send_counts, send_displs);
+            timing.merge_time += merge_timer.stop();
+        } else {
+            split_sorted_data(local_data, rank, size, comm, timing, config, send_counts, send_displs);
+        }
+        
+        // Exchange counts
+        comm_timer.start();
+        recv_total = exchange_counts(send_counts, recv_counts, recv_displs, comm);
+        if (workspace.reuse_splitters && sampled) {
+            workspace.pivot_imbalance = output_imbalance(recv_total, input_count, comm);
+        }
+        timing.comm_time += comm_timer.stop();
+    }
+    timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(T));
+    
+    comm_timer.start();
+    if (config.exchange == ExchangeMethod::Shared) {
+        // Step 7: Publish the sorted data in the workspace's shared window,
+        // regrown on every rank once any rank's data no longer fits; each
+        // run's offset in its owner's block comes from the owner's send_displs
+        std::vector<long long> run_offsets(size);
+        MPI_Alltoall(send_displs.data(), 1, MPI_LONG_LONG, run_offsets.data(), 1, MPI_LONG_LONG, comm);
+        int local_grow = !workspace.window || workspace.window->capacity() < local_data.size();
+        int grow = 0;
+        MPI_Allreduce(&local_grow, &grow, 1, MPI_INT, MPI_LOR, comm);
+        if (grow) {
+            workspace.window.reset();
+            workspace.window.reset(new SharedWindow<T>(local_data.size(), comm));
+        }
+        SharedWindow<T>& window = *workspace.window;
+        std::copy(local_data.begin(), local_data.end(), window.local());
+        window.sync();
+        timing.comm_time += comm_timer.stop();
+        
+        // Step 8: Merge the runs straight out of the peers' blocks. The
+        // input lives on in the window, so the merge writes over its
+        // storage: peak memory is the window plus the output.
+        merge_timer.start();
+        std::vector<Run<T>> runs;
+        for (int r = 0; r < size; ++r) {
+            const T* base = window.block(r) + run_offsets[r];
+            runs.push_back({base, base + recv_counts[r]});
+        }
+        merge_sorted_runs(runs, local_data, pool);
+        timing.merge_time += merge_timer.stop();
+        
+        // Peers may still be reading this rank's block
+        comm_timer.start();
+        window.sync();
+        timing.comm_time += comm_timer.stop();
+    } else {
+        // Step 7: All-to-all exchange, flat or through node leaders; the
+        // receive buffer only grows, so a reused one is not cleared
+        std::vector<T>& recv_buffer = workspace.recv_buffer;
+        if (recv_buffer.size() < recv_total) {
+            std::vector<T>().swap(recv_buffer);
+            recv_buffer.reserve(recv_total);
+            recv_buffer.resize(recv_total);
+        }
+        alltoallv_exchange(local_data.data(), send_counts, send_displs,
+                           recv_buffer.data(), recv_counts, recv_displs, comm, config.exchange);
+        timing.comm_time += comm_timer.stop();
+        
+        merge_timer.start();
+        if (config.low_memory) {
+            // Step 8: The received runs are all that is left to keep: free
+            // the input, then merge them inside recv_buffer
+            std::vector<T>().swap(local_data);
+            recv_buffer.resize(recv_total);
+            merge_runs_in_place(recv_buffer.data(), recv_total, recv_displs, pool);
+            local_data.swap(recv_buffer);
+        } else {
+            // Step 8: Merge received runs straight out of recv_buffer; the
+            // input's storage becomes the next call's merge output
+            merge_partitions(recv_buffer, recv_displs, recv_counts, workspace.merged, pool);
+            local_data.swap(workspace.merged);
+        }
+        timing.merge_time += merge_timer.stop();
+    }
+    
+    // Step 9 (optional): Exact rebalance back to the input distribution
+    if (config.exact_rebalance) {
+        comm_timer.start();
+        rebalance_layout(local_data.size(), input_count, comm, send_counts, send_displs);
+        timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(T));
+        redistribute(local_data, send_counts, send_displs, comm, config.exchange);
+        timing.comm_time += comm_timer.stop();
+    }
+    
+    timing.total_time = total_timer.stop();
+}
+
+template <typename T>
+void psrs_insert_batch(std::vector<T>& resident,
+                       std::vector<T>& batch,
+                       int rank,
+                       int size,
+                       MPI_Comm comm,
+                       TimingData& timing,
+                       const SortConfig& config) {
+    Timer total_timer(&timing.total_counts, "psrs_insert_batch");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+    
+    // The splitters are the resident array's rank boundaries: every rank's
+    // size and last key
     comm_timer.start();
-    MPI_Alltoall(send_counts.data(), 1, MPI_INT,
-                 recv_counts.data(), 1, MPI_INT, comm);
+    long long resident_count = resident.size();
+    std::vector<long long> resident_counts(size);
+    MPI_Allgather(&resident_count, 1, MPI_LONG_LONG, resident_counts.data(), 1, MPI_LONG_LONG, comm);
+    T last_key = resident.empty() ? T() : resident.back();
+    std::vector<T> last_keys(size);
+    MPI_Allgather(&last_key, 1, mpi_type<T>(), last_keys.data(), 1, mpi_type<T>(), comm);
+    timing.comm_time += comm_timer.stop();
     
-    // Calculate receive displacements and total receive size
-    int recv_total = 0;
-    for (int i = 0; i < size; ++i) {
-        recv_displs[i] = recv_total;
-        recv_total += recv_counts[i];
+    // Nothing resident yet: the first batch is sorted in full
+    if (std::all_of(resident_counts.begin(), resident_counts.end(),
+                    [](long long count) { return count == 0; })) {
+        timing.total_time = total_timer.stop();
+        resident.swap(batch);
+        batch.clear();
+        psrs_sort(resident, rank, size, comm, timing, config);
+        return;
     }
     
-    // Step 8: All-to-all exchange
-    std::vector<int> recv_buffer(recv_total);
-    MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_displs.data(), MPI_INT,
-                  recv_buffer.data(), recv_counts.data(), recv_displs.data(), MPI_INT,
-                  comm);
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
+    
+    // Step 1: Local sort of the batch
+    local_timer.start();
+    parallel_sort(batch, pool, config.local_sort);
+    timing.local_sort_time = local_timer.stop();
+    
+    // Step 2: A key goes to the first rank whose resident keys reach it,
+    // and keys above every resident one to the last rank. Empty ranks get
+    // nothing, so each rank's new keys stay within its neighbours' bounds.
+    merge_timer.start();
+    std::vector<long long> send_counts(size, 0);
+    std::vector<long long> send_displs(size, 0);
+    size_t first = 0;
+    for (int r = 0; r < size; ++r) {
+        size_t last = batch.size();
+        if (r + 1 < size) {
+            last = first;
+            if (resident_counts[r] > 0) {
+                last = std::upper_bound(batch.begin() + first, batch.end(), last_keys[r])
+                     - batch.begin();
+            }
+        }
+        send_displs[r] = first;
+        send_counts[r] = last - first;
+        first = last;
+    }
+    timing.merge_time += merge_timer.stop();
+    
+    // Step 3: Exchange the buckets straight into the tail of the resident data
+    comm_timer.start();
+    std::vector<long long> recv_counts;
+    std::vector<long long> recv_displs;
+    size_t recv_total = exchange_counts(send_counts, recv_counts, recv_displs, comm);
+    timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(T));
+    size_t old_count = resident.size();
+    resident.resize(old_count + recv_total);
+    alltoallv_exchange(batch.data(), send_counts, send_displs,
+                       resident.data() + old_count, recv_counts, recv_displs,
+                       comm, config.exchange);
+    std::vector<T>().swap(batch);
     timing.comm_time += comm_timer.stop();
     
-    // Step 9: Merge received partitions
+    // Step 4: Merge the received runs into one bucket, then the bucket into
+    // the resident keys from the back: only keys above its smallest move
     merge_timer.start();
-    std::vector<std::vector<int>> received_partitions(size);
-    for (int i = 0; i < size; ++i) {
-        received_partitions[i].assign(
-            recv_buffer.begin() + recv_displs[i],
-            recv_buffer.begin() + recv_displs[i] + recv_counts[i]
-        );
+    merge_runs_in_place(resident.data() + old_count, recv_total, recv_displs, pool);
+    merge_adjacent_runs(resident.data(), resident.data() + old_count,
+                        resident.data() + resident.size());
+    timing.merge_time += merge_timer.stop();
+    
+    // Step 5: Rebalance to an even share once the fullest rank passes the
+    // threshold
+    comm_timer.start();
+    double imbalance = output_imbalance(resident.size(), resident.size(), comm);
+    if (imbalance > config.rebalance_threshold) {
+        unsigned long long local_count = resident.size();
+        unsigned long long total_count = 0;
+        MPI_Allreduce(&local_count, &total_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+        size_t target = total_count / size + (static_cast<unsigned long long>(rank) < total_count % size);
+        rebalance_layout(resident.size(), target, comm, send_counts, send_displs);
+        timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(T));
+        redistribute(resident, send_counts, send_displs, comm, config.exchange);
+        timing.rebalanced = 1;
+    }
+    timing.comm_time += comm_timer.stop();
+    
+    timing.total_time = total_timer.stop();
+}
+
+template <typename K, typename P>
+void psrs_sort_soa(std::vector<K>& keys,
+                   std::vector<P>& payloads,
+                   int rank,
+                   int size,
+                   MPI_Comm comm,
+                   TimingData& timing,
+                   const SortConfig& config) {
+    Timer total_timer(&timing.total_counts, "psrs_sort");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+    
+    ThreadPool& pool = get_thread_pool(config.threads_per_rank);
+    size_t input_count = keys.size();
+    
+    // Step 1: Local sort of (key, index) pairs, then one gather of the
+    // payloads into key order
+    local_timer.start();
+    std::vector<KeyValue<K, std::int64_t>> order(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        order[i].key = keys[i];
+        order[i].value = i;
     }
+    parallel_sort(order, pool, config.local_sort);
     
-    merge_partitions(received_partitions, local_data);
+    std::vector<P> sorted_payloads(payloads.size());
+    pool.parallel_for(pool.size(), [&](int t) {
+        size_t first = order.size() * t / pool.size();
+        size_t last = order.size() * (t + 1) / pool.size();
+        for (size_t i = first; i < last; ++i) {
+            keys[i] = order[i].key;
+            sorted_payloads[i] = payloads[order[i].value];
+        }
+    });
+    payloads.swap(sorted_payloads);
+    std::vector<KeyValue<K, std::int64_t>>().swap(order);
+    std::vector<P>().swap(sorted_payloads);
+    timing.local_sort_time = local_timer.stop();
+    
+    // Steps 2-6: Splitters come from the keys alone; the split offsets are
+    // shared by both arrays
+    std::vector<long long> send_counts(size);
+    std::vector<long long> send_displs(size);
+    std::vector<long long> recv_counts(size);
+    std::vector<long long> recv_displs(size);
+    split_sorted_data(keys, rank, size, comm, timing, config, send_counts, send_displs);
+    
+    // Step 7: One all-to-all per array with the same layout
+    comm_timer.start();
+    size_t recv_total = exchange_counts(send_counts, recv_counts, recv_displs, comm);
+    
+    std::vector<K> key_buffer(recv_total);
+    std::vector<P> payload_buffer(recv_total);
+    alltoallv_exchange(keys.data(), send_counts, send_displs,
+                       key_buffer.data(), recv_counts, recv_displs, comm, config.exchange);
+    alltoallv_exchange(payloads.data(), send_counts, send_displs,
+                       payload_buffer.data(), recv_counts, recv_displs, comm, config.exchange);
+    timing.comm_time += comm_timer.stop();
+    timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(K) + sizeof(P));
+    
+    // Step 8: Merge on keys, carrying payloads along
+    merge_timer.start();
+    merge_partitions_soa(key_buffer, payload_buffer, recv_displs, recv_counts,
+                         keys, payloads, pool);
     timing.merge_time += merge_timer.stop();
     
+    // Step 9 (optional): Exact rebalance, the same layout for both arrays
+    if (config.exact_rebalance) {
+        std::vector<K>().swap(key_buffer);
+        std::vector<P>().swap(payload_buffer);
+        comm_timer.start();
+        rebalance_layout(keys.size(), input_count, comm, send_counts, send_displs);
+        timing.bytes_exchanged += remote_bytes(send_counts, rank, sizeof(K) + sizeof(P));
+        redistribute(keys, send_counts, send_displs, comm, config.exchange);
+        redistribute(payloads, send_counts, send_displs, comm, config.exchange);
+        timing.comm_time += comm_timer.stop();
+    }
+    
     timing.total_time = total_timer.stop();
 }
+
+#define INSTANTIATE_PSRS(T) \
+    template void psrs_sort<T>(std::vector<T>&, int, int, MPI_Comm, TimingData&, \
+                               const SortConfig&); \
+    template void psrs_sort<T>(std::vector<T>&, int, int, MPI_Comm, TimingData&, \
+                               const SortConfig&, PsrsWorkspace<T>&); \
+    template void psrs_insert_batch<T>(std::vector<T>&, std::vector<T>&, int, int, MPI_Comm, \
+                                       TimingData&, const SortConfig&); \
+    template void select_regular_samples<T>(const std::vector<T>&, std::vector<T>&, int); \
+    template void partition_by_pivots<T>(const std::vector<T>&, int, \
+                                         const std::vector<TaggedPivot<T>>&, \
+                                         std::vector<long long>&, std::vector<long long>&); \
+    template void merge_partitions<T>(const std::vector<T>&, const std::vector<long long>&, \
+                                      const std::vector<long long>&, std::vector<T>&, ThreadPool&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_PSRS)
+
+#define INSTANTIATE_PSRS_SOA(K, P) \
+    template void psrs_sort_soa<K, P>(std::vector<K>&, std::vector<P>&, int, int, MPI_Comm, \
+                                      TimingData&, const SortConfig&); \
+    template void merge_partitions_soa<K, P>(const std::vector<K>&, const std::vector<P>&, \
+                                             const std::vector<long long>&, const std::vector<long long>&, \
+                                             std::vector<K>&, std::vector<P>&, ThreadPool&);
+INSTANTIATE_PSRS_SOA(std::int64_t, std::int64_t)
+INSTANTIATE_PSRS_SOA(std::int64_t, FixedPayload<56>)
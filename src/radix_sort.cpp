@@ -0,0 +1,119 @@
+#include "radix_sort.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int RADIX_BITS = 8;
+constexpr int NUM_BUCKETS = 1 << RADIX_BITS;
+
+// Below this size the histogram overhead dominates
+constexpr size_t SMALL_SORT_THRESHOLD = 256;
+
+template <typename T>
+inline unsigned digit_of(const T& value, int pass) {
+    return (element_radix_key(value) >> (pass * RADIX_BITS)) & (NUM_BUCKETS - 1);
+}
+
+// Elements from p to the next 64-byte boundary, or a whole buffer when p
+// is on one or lines cannot start on element boundaries
+template <typename T, int WC_ELEMENTS>
+inline int elements_to_line(const T* p) {
+    size_t misalign = reinterpret_cast<uintptr_t>(p) % 64;
+    if (WC_ELEMENTS == 1 || misalign == 0 || misalign % sizeof(T) != 0) return WC_ELEMENTS;
+    return static_cast<int>((64 - misalign) / sizeof(T));
+}
+
+template <typename T>
+void scatter_pass(const T* src, T* dst, size_t n, int pass,
+                  const size_t* histogram) {
+    // Elements per write-combining buffer: one 64-byte cache line
+    constexpr int WC_ELEMENTS = sizeof(T) >= 64 ? 1 : static_cast<int>(64 / sizeof(T));
+
+    // Exclusive prefix sum gives each bucket's first output slot. A
+    // bucket's first flush only runs up to the next line boundary of dst,
+    // so every later one writes one whole aligned line.
+    size_t offsets[NUM_BUCKETS];
+    int wc_limit[NUM_BUCKETS];
+    size_t sum = 0;
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+        offsets[b] = sum;
+        wc_limit[b] = elements_to_line<T, WC_ELEMENTS>(dst + sum);
+        sum += histogram[b];
+    }
+
+    alignas(64) T wc_buffer[NUM_BUCKETS][WC_ELEMENTS];
+    int wc_fill[NUM_BUCKETS] = {0};
+
+    for (size_t i = 0; i < n; ++i) {
+        unsigned b = digit_of(src[i], pass);
+        wc_buffer[b][wc_fill[b]++] = src[i];
+        if (wc_fill[b] == wc_limit[b]) {
+            if (wc_limit[b] == WC_ELEMENTS) {
+                std::memcpy(dst + offsets[b], wc_buffer[b], sizeof(wc_buffer[b]));
+            } else {
+                std::memcpy(dst + offsets[b], wc_buffer[b], wc_fill[b] * sizeof(T));
+                wc_limit[b] = WC_ELEMENTS;
+            }
+            offsets[b] += wc_fill[b];
+            wc_fill[b] = 0;
+        }
+    }
+
+    // Flush partially filled buffers
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+        if (wc_fill[b] > 0) {
+            std::memcpy(dst + offsets[b], wc_buffer[b], wc_fill[b] * sizeof(T));
+        }
+    }
+}
+
+} // namespace
+
+template <typename T>
+void radix_sort(T* data, size_t n, T* buffer) {
+    if (n < SMALL_SORT_THRESHOLD) {
+        std::sort(data, data + n);
+        return;
+    }
+
+    using radix_type = decltype(element_radix_key(data[0]));
+    constexpr int NUM_PASSES = sizeof(radix_type) * 8 / RADIX_BITS;
+
+    // Pre-pass: histograms of every digit in one read of the data
+    std::vector<size_t> histograms(NUM_PASSES * NUM_BUCKETS, 0);
+    for (size_t i = 0; i < n; ++i) {
+        radix_type key = element_radix_key(data[i]);
+        for (int pass = 0; pass < NUM_PASSES; ++pass) {
+            histograms[pass * NUM_BUCKETS + ((key >> (pass * RADIX_BITS)) & (NUM_BUCKETS - 1))]++;
+        }
+    }
+
+    T* src = data;
+    T* dst = buffer;
+    for (int pass = 0; pass < NUM_PASSES; ++pass) {
+        const size_t* histogram = histograms.data() + pass * NUM_BUCKETS;
+
+        // Every key has the same digit: the pass would be a plain copy
+        if (histogram[digit_of(src[0], pass)] == n) continue;
+
+        scatter_pass(src, dst, n, pass, histogram);
+        std::swap(src, dst);
+    }
+
+    if (src != data) {
+        std::memcpy(static_cast<void*>(data), src, n * sizeof(T));
+    }
+}
+
+template <typename T>
+void radix_sort(std::vector<T>& data) {
+    std::vector<T> buffer(data.size());
+    radix_sort(data.data(), data.size(), buffer.data());
+}
+
+#define INSTANTIATE_RADIX_SORT(T) \
+    template void radix_sort<T>(std::vector<T>&); \
+    template void radix_sort<T>(T*, size_t, T*);
+FOR_EACH_SORT_TYPE(INSTANTIATE_RADIX_SORT)
@@ -0,0 +1,452 @@
+#include "selection.h"
+#include "psrs_sort.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Samples per open query over all ranks in the first round
+constexpr long long SAMPLES_PER_QUERY = 4096;
+
+// Candidates left on all ranks together below which they are gathered
+constexpr long long GATHER_THRESHOLD = 1 << 16;
+
+// One query's state: answered, or bracketed by two keys. Every key
+// strictly between lo and hi is still a candidate.
+template <typename T>
+struct Query {
+    long long k;                // Global rank sought
+    bool done = false;
+    T answer;
+    bool has_lo = false;
+    bool has_hi = false;
+    T lo;
+    T hi;
+    long long upto_lo = 0;      // Keys <= lo over all ranks
+    long long below_hi = 0;     // Keys < hi over all ranks
+};
+
+// Pivots the root picked for one open query; found is 0 when none of the
+// round's samples fell inside its bracket
+template <typename T>
+struct PivotPair {
+    T low;
+    T high;
+    int found;
+};
+
+// Open interval (lo, hi) of candidate keys, either end possibly unbounded
+template <typename T>
+struct Interval {
+    bool has_lo;
+    bool has_hi;
+    T lo;
+    T hi;
+};
+
+template <typename T>
+bool equivalent(const T& a, const T& b) {
+    return !(a < b) && !(b < a);
+}
+
+// Union of the open queries' brackets as disjoint intervals sorted by lo
+template <typename T>
+std::vector<Interval<T>> bracket_union(const std::vector<Query<T>>& queries) {
+    std::vector<Interval<T>> intervals;
+    for (const Query<T>& q : queries) {
+        if (!q.done) intervals.push_back({q.has_lo, q.has_hi, q.lo, q.hi});
+    }
+    std::sort(intervals.begin(), intervals.end(), [](const Interval<T>& a, const Interval<T>& b) {
+        if (!a.has_lo || !b.has_lo) return !a.has_lo && b.has_lo;
+        return a.lo < b.lo;
+    });
+    std::vector<Interval<T>> merged;
+    for (const Interval<T>& next : intervals) {
+        if (!merged.empty()) {
+            Interval<T>& last = merged.back();
+            if (!last.has_hi) continue;
+            if (!next.has_lo || next.lo < last.hi) {
+                if (!next.has_hi || last.hi < next.hi) {
+                    last.has_hi = next.has_hi;
+                    last.hi = next.hi;
+                }
+                continue;
+            }
+        }
+        merged.push_back(next);
+    }
+    return merged;
+}
+
+// Whether value lies strictly inside one of the disjoint sorted intervals
+template <typename T>
+bool in_union(const std::vector<Interval<T>>& intervals, const T& value) {
+    auto after = std::partition_point(intervals.begin(), intervals.end(),
+                                      [&](const Interval<T>& i) { return !i.has_lo || i.lo < value; });
+    if (after == intervals.begin()) return false;
+    const Interval<T>& i = *(after - 1);
+    return !i.has_hi || value < i.hi;
+}
+
+// The keys of queries.size() global ranks, with n known; the driver
+// behind every entry point
+template <typename T>
+void select_ranks(const std::vector<T>& data,
+                  const std::vector<long long>& ranks,
+                  long long n,
+                  MPI_Comm comm,
+                  TimingData& timing,
+                  std::vector<T>& result) {
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    MPI_Datatype type = mpi_type<T>();
+    MPI_Datatype pair_type = mpi_type<PivotPair<T>>();
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    result.assign(ranks.size(), T());
+    if (n == 0) return;
+
+    std::vector<Query<T>> queries(ranks.size());
+    size_t open = queries.size();
+    for (size_t i = 0; i < queries.size(); ++i) {
+        queries[i].k = std::min(std::max(ranks[i], 0LL), n - 1);
+        queries[i].below_hi = n;
+    }
+
+    // Round 1 reads the data in place; later rounds a filtered copy
+    const std::vector<T>* current = &data;
+    std::vector<T> candidates;
+    long long global_candidates = n;
+    long long sampling = SAMPLES_PER_QUERY;
+
+    std::vector<T> local_samples;
+    std::vector<T> all_samples;
+    std::vector<int> sample_counts(size);
+    std::vector<int> sample_displs(size);
+    std::vector<PivotPair<T>> pairs;
+    std::vector<T> probes;
+    std::vector<long long> local_hist;
+    std::vector<long long> global_hist;
+
+    while (open > 0 && global_candidates > GATHER_THRESHOLD) {
+        timing.splitter_rounds++;
+
+        // Regular samples of the candidates, in proportion to this rank's share
+        long long budget = sampling * static_cast<long long>(open);
+        long long local_count = current->size();
+        double wanted = std::ceil(static_cast<double>(budget) * local_count / global_candidates);
+        int samples_per_rank = static_cast<int>(std::min<double>(local_count, wanted));
+        select_regular_samples(*current, local_samples, samples_per_rank);
+
+        // Gather the samples at the root
+        comm_timer.start();
+        int local_sample_count = local_samples.size();
+        MPI_Gather(&local_sample_count, 1, MPI_INT, sample_counts.data(), 1, MPI_INT, 0, comm);
+        if (rank == 0) {
+            int total = 0;
+            for (int r = 0; r < size; ++r) {
+                sample_displs[r] = total;
+                total += sample_counts[r];
+            }
+            all_samples.resize(total);
+        }
+        MPI_Gatherv(local_samples.data(), local_sample_count, type,
+                    all_samples.data(), sample_counts.data(), sample_displs.data(), type,
+                    0, comm);
+        timing.bytes_exchanged += rank == 0 ? 0 : local_samples.size() * sizeof(T);
+        timing.comm_time += comm_timer.stop();
+
+        // Two pivots per open query, about sqrt(s) samples either side of
+        // where its answer should fall among the s samples in its bracket
+        merge_timer.start();
+        pairs.assign(open, PivotPair<T>());
+        if (rank == 0) {
+            std::sort(all_samples.begin(), all_samples.end());
+            size_t j = 0;
+            for (const Query<T>& q : queries) {
+                if (q.done) continue;
+                PivotPair<T>& pair = pairs[j++];
+                auto first = q.has_lo ? std::upper_bound(all_samples.begin(), all_samples.end(), q.lo)
+                                      : all_samples.begin();
+                auto last = q.has_hi ? std::lower_bound(first, all_samples.end(), q.hi)
+                                     : all_samples.end();
+                long long s = last - first;
+                pair.found = s > 0;
+                if (s == 0) continue;
+                double fraction = static_cast<double>(q.k - q.upto_lo) / (q.below_hi - q.upto_lo);
+                double position = fraction * s;
+                double margin = std::sqrt(static_cast<double>(s));
+                long long low = static_cast<long long>(std::floor(position - margin));
+                long long high = static_cast<long long>(std::ceil(position + margin));
+                pair.low = first[std::min(std::max(low, 0LL), s - 1)];
+                pair.high = first[std::min(std::max(high, 0LL), s - 1)];
+            }
+        }
+        timing.merge_time += merge_timer.stop();
+
+        comm_timer.start();
+        MPI_Bcast(pairs.data(), static_cast<int>(open), pair_type, 0, comm);
+        timing.comm_time += comm_timer.stop();
+
+        // Probe keys: every pivot and every bracket's lower end
+        probes.clear();
+        bool missed = false;
+        for (size_t i = 0, j = 0; i < queries.size(); ++i) {
+            if (queries[i].done) continue;
+            const PivotPair<T>& pair = pairs[j++];
+            if (queries[i].has_lo) probes.push_back(queries[i].lo);
+            if (!pair.found) {
+                missed = true;
+                continue;
+            }
+            probes.push_back(pair.low);
+            probes.push_back(pair.high);
+        }
+        std::sort(probes.begin(), probes.end());
+        probes.erase(std::unique(probes.begin(), probes.end(), equivalent<T>), probes.end());
+        size_t m = probes.size();
+
+        // Candidate histogram: below each probe in [0, m), up to it in [m, 2m)
+        local_timer.start();
+        local_hist.assign(2 * m, 0);
+        for (const T& value : *current) {
+            size_t i = std::lower_bound(probes.begin(), probes.end(), value) - probes.begin();
+            if (i == m) continue;
+            if (value < probes[i]) {
+                local_hist[i]++;        // Between probes i-1 and i
+            } else {
+                local_hist[m + i]++;    // Equal to probe i
+            }
+        }
+        timing.local_sort_time += local_timer.stop();
+        // Prefix sums turn the tallies into counts below / up to each probe
+        long long running = 0;
+        for (size_t i = 0; i < m; ++i) {
+            running += local_hist[i];
+            local_hist[i] = running;
+            running += local_hist[m + i];
+            local_hist[m + i] = running;
+        }
+        global_hist.resize(2 * m);
+        comm_timer.start();
+        MPI_Allreduce(local_hist.data(), global_hist.data(), static_cast<int>(2 * m),
+                      MPI_LONG_LONG, MPI_SUM, comm);
+        timing.comm_time += comm_timer.stop();
+
+        auto probe_index = [&](const T& key) {
+            return std::lower_bound(probes.begin(), probes.end(), key) - probes.begin();
+        };
+
+        // Answer or narrow every query that got pivots
+        merge_timer.start();
+        for (size_t i = 0, j = 0; i < queries.size(); ++i) {
+            Query<T>& q = queries[i];
+            if (q.done) continue;
+            const PivotPair<T>& pair = pairs[j++];
+            if (!pair.found) continue;
+            // Every key of the bracket is still a candidate, so the keys
+            // below a pivot are those up to lo plus the candidates between
+            long long base = q.upto_lo - (q.has_lo ? global_hist[m + probe_index(q.lo)] : 0);
+            size_t a = probe_index(pair.low);
+            size_t b = probe_index(pair.high);
+            long long below_a = base + global_hist[a];
+            long long upto_a = base + global_hist[m + a];
+            long long below_b = base + global_hist[b];
+            long long upto_b = base + global_hist[m + b];
+            if (q.k >= below_a && q.k < upto_a) {
+                q.done = true;
+                q.answer = pair.low;
+            } else if (q.k >= below_b && q.k < upto_b) {
+                q.done = true;
+                q.answer = pair.high;
+            } else if (q.k < below_a) {
+                q.has_hi = true;
+                q.hi = pair.low;
+                q.below_hi = below_a;
+            } else if (q.k >= upto_b) {
+                q.has_lo = true;
+                q.lo = pair.high;
+                q.upto_lo = upto_b;
+            } else {
+                q.has_lo = true;
+                q.lo = pair.low;
+                q.upto_lo = upto_a;
+                q.has_hi = true;
+                q.hi = pair.high;
+                q.below_hi = below_b;
+            }
+            if (q.done) open--;
+        }
+        if (missed) sampling = std::min(4 * sampling, global_candidates);
+        timing.merge_time += merge_timer.stop();
+
+        // Keep only candidates inside some open bracket
+        local_timer.start();
+        std::vector<Interval<T>> intervals = bracket_union(queries);
+        std::vector<T> kept;
+        for (const T& value : *current) {
+            if (in_union(intervals, value)) kept.push_back(value);
+        }
+        candidates.swap(kept);
+        current = &candidates;
+        timing.local_sort_time += local_timer.stop();
+
+        long long local_left = candidates.size();
+        comm_timer.start();
+        MPI_Allreduce(&local_left, &global_candidates, 1, MPI_LONG_LONG, MPI_SUM, comm);
+        timing.comm_time += comm_timer.stop();
+    }
+
+    // Few candidates left: gather them everywhere and read the answers off
+    if (open > 0) {
+        comm_timer.start();
+        int local_count = current->size();
+        MPI_Allgather(&local_count, 1, MPI_INT, sample_counts.data(), 1, MPI_INT, comm);
+        int total = 0;
+        for (int r = 0; r < size; ++r) {
+            sample_displs[r] = total;
+            total += sample_counts[r];
+        }
+        std::vector<T> gathered(total);
+        MPI_Allgatherv(current->data(), local_count, type,
+                       gathered.data(), sample_counts.data(), sample_displs.data(), type, comm);
+        timing.bytes_exchanged += static_cast<size_t>(local_count) * sizeof(T) * (size - 1);
+        timing.comm_time += comm_timer.stop();
+
+        merge_timer.start();
+        std::sort(gathered.begin(), gathered.end());
+        for (Query<T>& q : queries) {
+            if (q.done) continue;
+            long long skipped = q.has_lo
+                              ? std::upper_bound(gathered.begin(), gathered.end(), q.lo) - gathered.begin()
+                              : 0;
+            q.answer = gathered[skipped + q.k - q.upto_lo];
+            q.done = true;
+        }
+        timing.merge_time += merge_timer.stop();
+    }
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        result[i] = queries[i].answer;
+    }
+}
+
+// Elements on all ranks together
+template <typename T>
+long long global_count(const std::vector<T>& data, MPI_Comm comm, TimingData& timing) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    long long local = data.size();
+    long long n = 0;
+    comm_timer.start();
+    MPI_Allreduce(&local, &n, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    timing.comm_time += comm_timer.stop();
+    return n;
+}
+
+} // namespace
+
+template <typename T>
+void distributed_select(const std::vector<T>& data,
+                        const std::vector<long long>& ranks,
+                        MPI_Comm comm,
+                        TimingData& timing,
+                        std::vector<T>& result) {
+    Timer total_timer(&timing.total_counts, "distributed_select");
+    total_timer.start();
+    long long n = global_count(data, comm, timing);
+    select_ranks(data, ranks, n, comm, timing, result);
+    timing.total_time = total_timer.stop();
+}
+
+template <typename T>
+void distributed_quantiles(const std::vector<T>& data,
+                           const std::vector<double>& fractions,
+                           MPI_Comm comm,
+                           TimingData& timing,
+                           std::vector<T>& result) {
+    Timer total_timer(&timing.total_counts, "distributed_quantiles");
+    total_timer.start();
+    long long n = global_count(data, comm, timing);
+    std::vector<long long> ranks(fractions.size());
+    for (size_t i = 0; i < fractions.size(); ++i) {
+        double fraction = std::min(std::max(fractions[i], 0.0), 1.0);
+        ranks[i] = std::llround(fraction * std::max(0LL, n - 1));
+    }
+    select_ranks(data, ranks, n, comm, timing, result);
+    timing.total_time = total_timer.stop();
+}
+
+template <typename T>
+void distributed_top_k(const std::vector<T>& data,
+                       long long k,
+                       MPI_Comm comm,
+                       TimingData& timing,
+                       std::vector<T>& top) {
+    Timer total_timer(&timing.total_counts, "distributed_top_k");
+    Timer local_timer(&timing.local_sort_counts, "local_sort");
+    Timer comm_timer(&timing.comm_counts, "comm");
+    Timer merge_timer(&timing.merge_counts, "merge");
+    total_timer.start();
+    top.clear();
+    long long n = global_count(data, comm, timing);
+    k = std::min(std::max(k, 0LL), n);
+    if (k == 0) {
+        timing.total_time = total_timer.stop();
+        return;
+    }
+
+    // The smallest selected key
+    std::vector<T> threshold;
+    select_ranks(data, std::vector<long long>(1, n - k), n, comm, timing, threshold);
+    const T& t = threshold[0];
+
+    // Everything above it, and the equal copies in rank order up to k
+    local_timer.start();
+    long long counts[2] = {0, 0};     // Above, equal
+    for (const T& value : data) {
+        if (t < value) {
+            top.push_back(value);
+            counts[0]++;
+        } else if (!(value < t)) {
+            counts[1]++;
+        }
+    }
+    timing.local_sort_time += local_timer.stop();
+
+    long long above = 0;
+    long long equal_before = 0;
+    comm_timer.start();
+    MPI_Allreduce(&counts[0], &above, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Exscan(&counts[1], &equal_before, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    timing.comm_time += comm_timer.stop();
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) equal_before = 0;
+
+    local_timer.start();
+    long long take = std::min(counts[1], std::max(0LL, k - above - equal_before));
+    for (auto it = data.begin(); take > 0 && it != data.end(); ++it) {
+        if (equivalent(*it, t)) {
+            top.push_back(*it);
+            take--;
+        }
+    }
+    timing.local_sort_time += local_timer.stop();
+
+    merge_timer.start();
+    std::sort(top.begin(), top.end(), [](const T& a, const T& b) { return b < a; });
+    timing.merge_time += merge_timer.stop();
+    timing.total_time = total_timer.stop();
+}
+
+#define INSTANTIATE_SELECTION(T) \
+    template void distributed_select<T>(const std::vector<T>&, const std::vector<long long>&, \
+                                        MPI_Comm, TimingData&, std::vector<T>&); \
+    template void distributed_quantiles<T>(const std::vector<T>&, const std::vector<double>&, \
+                                           MPI_Comm, TimingData&, std::vector<T>&); \
+    template void distributed_top_k<T>(const std::vector<T>&, long long, MPI_Comm, \
+                                       TimingData&, std::vector<T>&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_SELECTION)
@@ -0,0 +1,82 @@
+#include "shared_window.h"
+#include <algorithm>
+#include <numeric>
+
+template <typename T>
+SharedWindow<T>::SharedWindow(size_t capacity, MPI_Comm comm)
+    : comm(comm), local_capacity(capacity) {
+    int size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    T* base = nullptr;
+    MPI_Win_allocate_shared(static_cast<MPI_Aint>(capacity * sizeof(T)), sizeof(T),
+                            MPI_INFO_NULL, comm, &base, &win);
+
+    // Peers' blocks mapped into this process
+    blocks.resize(size);
+    for (int r = 0; r < size; ++r) {
+        MPI_Aint bytes;
+        int disp_unit;
+        MPI_Win_shared_query(win, r, &bytes, &disp_unit, &blocks[r]);
+    }
+
+    // One passive-target epoch for the window's lifetime; sync() orders
+    // the loads and stores inside it
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+}
+
+template <typename T>
+SharedWindow<T>::~SharedWindow() {
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+}
+
+template <typename T>
+void SharedWindow<T>::sync() {
+    MPI_Win_sync(win);
+    MPI_Barrier(comm);
+    MPI_Win_sync(win);
+}
+
+template <typename T>
+void SharedWindow<T>::fence() {
+    MPI_Win_sync(win);
+}
+
+template <typename T>
+void shared_alltoallv(const T* send_buffer,
+                      const std::vector<long long>& send_counts,
+                      const std::vector<long long>& send_displs,
+                      T* recv_buffer,
+                      const std::vector<long long>& recv_counts,
+                      const std::vector<long long>& recv_displs,
+                      MPI_Comm comm) {
+    int size = send_counts.size();
+    
+    // Where each peer's run for this rank starts in the peer's block
+    std::vector<long long> peer_displs(size);
+    MPI_Alltoall(send_displs.data(), 1, MPI_LONG_LONG, peer_displs.data(), 1, MPI_LONG_LONG, comm);
+    
+    size_t send_total = std::accumulate(send_counts.begin(), send_counts.end(), size_t(0));
+    SharedWindow<T> window(send_total, comm);
+    std::copy(send_buffer, send_buffer + send_total, window.local());
+    window.sync();
+    
+    for (int r = 0; r < size; ++r) {
+        const T* run = window.block(r) + peer_displs[r];
+        std::copy(run, run + recv_counts[r], recv_buffer + recv_displs[r]);
+    }
+    
+    // Peers may still be reading this rank's block
+    window.sync();
+}
+
+#define INSTANTIATE_SHARED_WINDOW(T) \
+    template class SharedWindow<T>; \
+    template void shared_alltoallv<T>(const T*, const std::vector<long long>&, \
+                                      const std::vector<long long>&, T*, \
+                                      const std::vector<long long>&, \
+                                      const std::vector<long long>&, MPI_Comm);
+FOR_EACH_SORT_TYPE(INSTANTIATE_SHARED_WINDOW)
+INSTANTIATE_SHARED_WINDOW(FixedPayload<56>)
@@ -0,0 +1,84 @@
+#include "sort_plan.h"
+#include "hierarchical_exchange.h"
+#include "memory_usage.h"
+
+namespace {
+
+// Reserve capacity elements, backed by huge pages if asked
+template <typename T>
+void reserve_buffer(std::vector<T>& buffer, size_t capacity, bool huge_pages) {
+    buffer.reserve(capacity);
+    if (huge_pages && buffer.capacity() > 0) {
+        advise_huge_pages(buffer.data(), buffer.capacity() * sizeof(T));
+    }
+}
+
+} // namespace
+
+template <typename T>
+SortPlan<T>::SortPlan(MPI_Comm comm, size_t capacity, SortAlgorithm algorithm,
+                      const SortConfig& config, const PlanOptions& options)
+    : comm(MPI_COMM_NULL), rank(0), size(1), algorithm(algorithm), config(config),
+      executions(0), splitter_reuses(0) {
+    MPI_Comm_dup(comm, &this->comm);
+    MPI_Comm_rank(this->comm, &rank);
+    MPI_Comm_size(this->comm, &size);
+    this->config.memory_budget = 0;
+    
+    // Build the node grouping now rather than inside the first execute()
+    if (config.exchange != ExchangeMethod::Flat) {
+        shared_memory_nodes(this->comm);
+    }
+    
+    if (algorithm == SortAlgorithm::Bitonic) {
+        reserve_buffer(bitonic.partner, capacity, options.huge_pages);
+        reserve_buffer(bitonic.kept, capacity, options.huge_pages);
+        return;
+    }
+    if (algorithm == SortAlgorithm::Radix) return;
+    
+    psrs.reuse_splitters = options.reuse_splitters;
+    psrs.send_counts.resize(size);
+    psrs.send_displs.resize(size);
+    psrs.recv_counts.resize(size);
+    psrs.recv_displs.resize(size);
+    psrs.pivots.reserve(size - 1);
+    reserve_buffer(psrs.recv_buffer, capacity, options.huge_pages);
+    psrs.recv_buffer.resize(capacity);
+    reserve_buffer(psrs.merged, capacity, options.huge_pages);
+}
+
+template <typename T>
+SortPlan<T>::~SortPlan() {
+    psrs.window.reset();
+    MPI_Comm_free(&comm);
+}
+
+template <typename T>
+void SortPlan<T>::execute(std::vector<T>& data) {
+    TimingData timing;
+    execute(data, timing);
+}
+
+template <typename T>
+void SortPlan<T>::execute(std::vector<T>& data, TimingData& timing) {
+    if (algorithm == SortAlgorithm::Bitonic) {
+        bitonic_sort(data, rank, size, comm, timing, config, bitonic);
+    } else if (algorithm == SortAlgorithm::Radix) {
+        distributed_radix_sort(data, rank, size, comm, timing, config);
+    } else {
+        psrs_sort(data, rank, size, comm, timing, config, psrs);
+        if (psrs.reused) splitter_reuses++;
+    }
+    executions++;
+}
+
+template <typename T>
+void SortPlan<T>::reset_splitters() {
+    psrs.pivots.clear();
+    psrs.pivot_imbalance = 0;
+}
+
+#define INSTANTIATE_SORT_PLAN(T) \
+    template class SortPlan<T>;
+FOR_EACH_SORT_TYPE(INSTANTIATE_SORT_PLAN)
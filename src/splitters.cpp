@@ -0,0 +1,203 @@
+#include "splitters.h"
+#include "psrs_sort.h"
+#include <algorithm>
+
+namespace {
+
+// Probes each rank draws per unsettled splitter in every refinement round
+constexpr int PROBES_PER_SPLITTER = 4;
+
+// A splitter's current state: settled on a key, or bracketed by two probes
+template <typename T>
+struct SplitterState {
+    bool settled = false;
+    T key;                  // Settled: boundary sits inside the run of key
+    long long take_equal = 0;   // Settled: copies of key left of the boundary
+    bool has_lo = false;    // Bracket: every probe <= lo ends before the target
+    bool has_hi = false;    // Bracket: every probe >= hi starts after the target
+    T lo;
+    T hi;
+};
+
+// Append count evenly spaced elements of data[first, last) to probes
+template <typename T>
+void sample_range(const std::vector<T>& data, size_t first, size_t last,
+                  int count, std::vector<T>& probes) {
+    size_t length = last - first;
+    if (length == 0) return;
+    for (int j = 0; j < count; ++j) {
+        size_t offset = (2 * j + 1) * length / (2 * count);
+        probes.push_back(data[first + offset]);
+    }
+}
+
+// Sort and drop equivalent probes
+template <typename T>
+void sort_unique(std::vector<T>& probes) {
+    std::sort(probes.begin(), probes.end());
+    auto last = std::unique(probes.begin(), probes.end(),
+                            [](const T& a, const T& b) { return !(a < b) && !(b < a); });
+    probes.erase(last, probes.end());
+}
+
+} // namespace
+
+template <typename T>
+int histogram_partition(const std::vector<T>& sorted_data,
+                        const std::vector<long long>& targets,
+                        long long tolerance,
+                        MPI_Comm comm,
+                        TimingData& timing,
+                        std::vector<long long>& send_counts,
+                        std::vector<long long>& send_displs) {
+    Timer comm_timer(&timing.comm_counts, "comm");
+    MPI_Datatype type = mpi_type<T>();
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    size_t num_splitters = targets.size();
+    std::vector<SplitterState<T>> splitters(num_splitters);
+
+    // Round 1 probes: regular samples of the whole local range
+    std::vector<T> local_probes;
+    select_regular_samples(sorted_data, local_probes, PROBES_PER_SPLITTER * size);
+
+    int rounds = 0;
+    size_t unsettled = num_splitters;
+    std::vector<int> probe_counts(size);
+    std::vector<int> probe_displs(size);
+    std::vector<T> probes;
+    std::vector<long long> local_hist;
+    std::vector<long long> global_hist;
+
+    while (unsettled > 0) {
+        rounds++;
+
+        // Share every rank's probes
+        sort_unique(local_probes);
+        int local_probe_count = local_probes.size();
+        comm_timer.start();
+        MPI_Allgather(&local_probe_count, 1, MPI_INT, probe_counts.data(), 1, MPI_INT, comm);
+        int total_probes = 0;
+        for (int r = 0; r < size; ++r) {
+            probe_displs[r] = total_probes;
+            total_probes += probe_counts[r];
+        }
+        probes.resize(total_probes);
+        MPI_Allgatherv(local_probes.data(), local_probe_count, type,
+                       probes.data(), probe_counts.data(), probe_displs.data(), type, comm);
+        timing.comm_time += comm_timer.stop();
+
+        // No data anywhere: every partition is empty
+        if (probes.empty()) break;
+        sort_unique(probes);
+        size_t m = probes.size();
+
+        // Global histogram: keys < probe in [0, m), keys <= probe in [m, 2m)
+        local_hist.assign(2 * m, 0);
+        auto first = sorted_data.begin();
+        for (size_t q = 0; q < m; ++q) {
+            first = std::lower_bound(first, sorted_data.end(), probes[q]);
+            local_hist[q] = first - sorted_data.begin();
+            local_hist[m + q] = std::upper_bound(first, sorted_data.end(), probes[q])
+                              - sorted_data.begin();
+        }
+        global_hist.resize(2 * m);
+        comm_timer.start();
+        MPI_Allreduce(local_hist.data(), global_hist.data(), static_cast<int>(2 * m),
+                      MPI_LONG_LONG, MPI_SUM, comm);
+        timing.comm_time += comm_timer.stop();
+        const long long* below = global_hist.data();
+        const long long* upto = global_hist.data() + m;
+
+        // Settle splitters whose boundary a probe can place within tolerance
+        for (size_t i = 0; i < num_splitters; ++i) {
+            SplitterState<T>& s = splitters[i];
+            if (s.settled) continue;
+            long long t = targets[i];
+
+            // First probe whose run reaches the target
+            size_t q = std::lower_bound(upto, upto + m, t) - upto;
+            long long miss_hi = (q < m) ? std::max(0LL, below[q] - t) : -1;
+            long long miss_lo = (q > 0) ? t - upto[q - 1] : -1;
+
+            if (miss_hi >= 0 && miss_hi <= tolerance && (miss_lo < 0 || miss_hi <= miss_lo)) {
+                s.settled = true;
+                s.key = probes[q];
+                s.take_equal = std::max(0LL, t - below[q]);
+            } else if (miss_lo >= 0 && miss_lo <= tolerance) {
+                s.settled = true;
+                s.key = probes[q - 1];
+                s.take_equal = upto[q - 1] - below[q - 1];
+            } else {
+                if (q > 0) {
+                    s.has_lo = true;
+                    s.lo = probes[q - 1];
+                }
+                if (q < m) {
+                    s.has_hi = true;
+                    s.hi = probes[q];
+                }
+            }
+            if (s.settled) unsettled--;
+        }
+
+        // Next probes come from strictly inside each open bracket
+        local_probes.clear();
+        for (const SplitterState<T>& s : splitters) {
+            if (s.settled) continue;
+            size_t lo = s.has_lo
+                      ? std::upper_bound(sorted_data.begin(), sorted_data.end(), s.lo) - sorted_data.begin()
+                      : 0;
+            size_t hi = s.has_hi
+                      ? std::lower_bound(sorted_data.begin(), sorted_data.end(), s.hi) - sorted_data.begin()
+                      : sorted_data.size();
+            sample_range(sorted_data, lo, std::max(lo, hi), PROBES_PER_SPLITTER, local_probes);
+        }
+    }
+
+    // Local boundaries: all keys below the splitter key, plus this rank's
+    // share of the equal keys, handed out in rank order
+    std::vector<long long> local_equal(num_splitters, 0);
+    std::vector<long long> below_positions(num_splitters, 0);
+    for (size_t i = 0; i < num_splitters; ++i) {
+        if (!splitters[i].settled) continue;
+        auto range = std::equal_range(sorted_data.begin(), sorted_data.end(), splitters[i].key);
+        below_positions[i] = range.first - sorted_data.begin();
+        local_equal[i] = range.second - range.first;
+    }
+    std::vector<long long> equal_before(num_splitters, 0);
+    comm_timer.start();
+    MPI_Exscan(local_equal.data(), equal_before.data(), static_cast<int>(num_splitters),
+               MPI_LONG_LONG, MPI_SUM, comm);
+    timing.comm_time += comm_timer.stop();
+    if (rank == 0) {
+        std::fill(equal_before.begin(), equal_before.end(), 0);
+    }
+
+    send_counts.assign(size, 0);
+    send_displs.assign(size, 0);
+    long long previous = 0;
+    for (int k = 0; k < size; ++k) {
+        long long boundary = sorted_data.size();
+        if (k + 1 < size) {
+            size_t i = k;
+            long long take = std::min(local_equal[i],
+                                      std::max(0LL, splitters[i].take_equal - equal_before[i]));
+            boundary = splitters[i].settled ? below_positions[i] + take : 0;
+        }
+        boundary = std::max(boundary, previous);
+        send_displs[k] = previous;
+        send_counts[k] = boundary - previous;
+        previous = boundary;
+    }
+
+    return rounds;
+}
+
+#define INSTANTIATE_SPLITTERS(T) \
+    template int histogram_partition<T>(const std::vector<T>&, const std::vector<long long>&, \
+                                        long long, MPI_Comm, TimingData&, \
+                                        std::vector<long long>&, std::vector<long long>&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_SPLITTERS)
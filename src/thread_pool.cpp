@@ -0,0 +1,85 @@
+#include "thread_pool.h"
+#include <memory>
+
+ThreadPool::ThreadPool(int num_threads)
+    : current_task(nullptr), num_tasks(0), next_task(0),
+      active_workers(0), generation(0), stopping(false) {
+    for (int i = 1; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::drain_tasks() {
+    int task;
+    while ((task = next_task.fetch_add(1)) < num_tasks) {
+        (*current_task)(task);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned long seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+        }
+
+        drain_tasks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active_workers == 0) {
+            work_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)>& task) {
+    if (count <= 0) return;
+
+    // Nothing to hand out: run inline
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_task = &task;
+        num_tasks = count;
+        next_task.store(0);
+        active_workers = static_cast<int>(workers.size());
+        ++generation;
+    }
+    work_ready.notify_all();
+
+    drain_tasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [&] { return active_workers == 0; });
+    current_task = nullptr;
+}
+
+ThreadPool& get_thread_pool(int num_threads) {
+    static std::unique_ptr<ThreadPool> pool;
+    if (num_threads < 1) num_threads = 1;
+    if (!pool || pool->size() != num_threads) {
+        pool.reset();
+        pool.reset(new ThreadPool(num_threads));
+    }
+    return *pool;
+}
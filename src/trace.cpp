@@ -0,0 +1,194 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    double begin;           // This rank's MPI_Wtime clock
+    double end;
+    long long arg;
+    int thread;
+};
+
+constexpr int SYNC_ROUNDS = 10;
+constexpr int TRACE_TAG = 7301;
+constexpr size_t SEND_CHUNK = size_t(1) << 30;
+
+std::vector<TraceEvent> events;
+std::atomic<size_t> next_event(0);
+std::atomic<bool> recording(false);
+std::atomic<int> next_thread(0);
+thread_local int thread_index = -1;
+
+// Offset of this rank's clock from rank 0's, measured at two local times
+double sync_time[2] = {0, 0};
+double sync_offset[2] = {0, 0};
+double origin = 0;          // trace_start() on rank 0's clock
+
+/**
+ * Offset of this rank's MPI_Wtime from rank 0's
+ *
+ * Rank 0 pings every rank in turn; of SYNC_ROUNDS round trips the
+ * shortest gives the estimate remote - (send + receive) / 2. Zero when
+ * the library reports MPI_WTIME_IS_GLOBAL. Collective.
+ */
+double clock_offset(MPI_Comm comm, double& when) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    when = MPI_Wtime();
+    
+    int* is_global = nullptr;
+    int found = 0;
+    MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_WTIME_IS_GLOBAL, &is_global, &found);
+    if (found && *is_global) return 0.0;
+    
+    std::vector<double> offsets(rank == 0 ? size : 0, 0.0);
+    double offset = 0.0;
+    if (rank == 0) {
+        for (int r = 1; r < size; ++r) {
+            double best_round_trip = std::numeric_limits<double>::max();
+            for (int i = 0; i < SYNC_ROUNDS; ++i) {
+                double sent = MPI_Wtime();
+                double remote = 0;
+                MPI_Send(&sent, 1, MPI_DOUBLE, r, TRACE_TAG, comm);
+                MPI_Recv(&remote, 1, MPI_DOUBLE, r, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+                double received = MPI_Wtime();
+                if (received - sent < best_round_trip) {
+                    best_round_trip = received - sent;
+                    offsets[r] = remote - (sent + received) / 2;
+                }
+            }
+        }
+    } else {
+        for (int i = 0; i < SYNC_ROUNDS; ++i) {
+            double ping = 0;
+            MPI_Recv(&ping, 1, MPI_DOUBLE, 0, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+            double now = MPI_Wtime();
+            MPI_Send(&now, 1, MPI_DOUBLE, 0, TRACE_TAG, comm);
+        }
+    }
+    MPI_Scatter(offsets.data(), 1, MPI_DOUBLE, &offset, 1, MPI_DOUBLE, 0, comm);
+    return offset;
+}
+
+// Microseconds since the start of the trace on rank 0's clock, with the
+// offset interpolated between the two measurements
+double aligned_us(double local_time) {
+    double offset = sync_offset[0];
+    if (sync_time[1] > sync_time[0]) {
+        offset += (sync_offset[1] - sync_offset[0])
+                * (local_time - sync_time[0]) / (sync_time[1] - sync_time[0]);
+    }
+    return (local_time - offset - origin) * 1e6;
+}
+
+// This rank's events as JSON objects, each preceded by ",\n"
+std::string rank_events_json(int rank) {
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+        << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+    out << ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << rank
+        << ",\"args\":{\"sort_index\":" << rank << "}}";
+    
+    size_t total = next_event.load();
+    size_t count = std::min(total, events.size());
+    for (size_t i = total - count; i < total; ++i) {
+        const TraceEvent& e = events[i % events.size()];
+        out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+            << "\",\"ph\":\"X\",\"pid\":" << rank << ",\"tid\":" << e.thread
+            << ",\"ts\":" << aligned_us(e.begin) << ",\"dur\":" << (e.end - e.begin) * 1e6;
+        if (e.arg >= 0) {
+            out << ",\"args\":{\"n\":" << e.arg << "}";
+        }
+        out << "}";
+    }
+    return out.str();
+}
+
+} // namespace
+
+void trace_start(size_t capacity, MPI_Comm comm) {
+    recording = false;
+    events.assign(std::max<size_t>(1, capacity), TraceEvent());
+    next_event = 0;
+    thread_index = 0;
+    next_thread = 1;
+    
+    sync_offset[0] = clock_offset(comm, sync_time[0]);
+    sync_time[1] = sync_time[0];
+    sync_offset[1] = sync_offset[0];
+    
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    origin = rank == 0 ? sync_time[0] : 0.0;
+    MPI_Bcast(&origin, 1, MPI_DOUBLE, 0, comm);
+    recording = true;
+}
+
+bool trace_enabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+void trace_record(const char* name, const char* category, double begin, double end,
+                  long long arg) {
+    if (!recording.load(std::memory_order_relaxed)) return;
+    if (thread_index < 0) thread_index = next_thread++;
+    size_t slot = next_event.fetch_add(1, std::memory_order_relaxed) % events.size();
+    events[slot] = {name, category, begin, end, arg, thread_index};
+}
+
+bool trace_write(const std::string& path, MPI_Comm comm,
+                 long long* recorded, long long* dropped) {
+    recording = false;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    sync_offset[1] = clock_offset(comm, sync_time[1]);
+    
+    long long local_totals[2] = {static_cast<long long>(next_event.load()), 0};
+    local_totals[1] = std::max(0LL, local_totals[0] - static_cast<long long>(events.size()));
+    long long totals[2] = {0, 0};
+    MPI_Reduce(local_totals, totals, 2, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    if (recorded) *recorded = totals[0];
+    if (dropped) *dropped = totals[1];
+    
+    // Rank 0 writes its own events, then every other rank's in turn, so at
+    // most one rank's text is held there at a time
+    std::string text = rank_events_json(rank);
+    std::vector<TraceEvent>().swap(events);
+    bool ok = true;
+    if (rank == 0) {
+        std::ofstream file(path);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << text.substr(2);
+        for (int r = 1; r < size; ++r) {
+            unsigned long long length = 0;
+            MPI_Recv(&length, 1, MPI_UNSIGNED_LONG_LONG, r, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+            text.resize(length);
+            for (size_t first = 0; first < length; first += SEND_CHUNK) {
+                int count = static_cast<int>(std::min<size_t>(SEND_CHUNK, length - first));
+                MPI_Recv(&text[first], count, MPI_CHAR, r, TRACE_TAG, comm, MPI_STATUS_IGNORE);
+            }
+            file << text;
+        }
+        file << "\n]}\n";
+        ok = file.good();
+    } else {
+        unsigned long long length = text.size();
+        MPI_Send(&length, 1, MPI_UNSIGNED_LONG_LONG, 0, TRACE_TAG, comm);
+        for (size_t first = 0; first < length; first += SEND_CHUNK) {
+            int count = static_cast<int>(std::min<size_t>(SEND_CHUNK, length - first));
+            MPI_Send(&text[first], count, MPI_CHAR, 0, TRACE_TAG, comm);
+        }
+    }
+    return ok;
+}
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "sort_types.h"
 #include <algorithm>
 #include <random>
 #include <fstream>
@@ -8,25 +9,229 @@
 #include <sstream>
 #include <numeric>
 #include <cmath>
+#include <cctype>
 #include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
 
-void generate_random_data(std::vector<int>& data, unsigned int seed, int rank) {
+namespace {
+
+// Uniform key distribution per key type
+template <typename K>
+struct KeyDistribution {
+    std::uniform_int_distribution<K> dis{std::numeric_limits<K>::min(),
+                                         std::numeric_limits<K>::max()};
+    K operator()(std::mt19937_64& gen) { return dis(gen); }
+};
+
+template <>
+struct KeyDistribution<int> {
+    std::uniform_int_distribution<int> dis{0, 1000000000};
+    int operator()(std::mt19937_64& gen) { return dis(gen); }
+};
+
+template <>
+struct KeyDistribution<float> {
+    std::uniform_real_distribution<float> dis{-1e9f, 1e9f};
+    float operator()(std::mt19937_64& gen) { return dis(gen); }
+};
+
+template <>
+struct KeyDistribution<double> {
+    std::uniform_real_distribution<double> dis{-1e9, 1e9};
+    double operator()(std::mt19937_64& gen) { return dis(gen); }
+};
+
+inline std::int64_t global_row_id(int rank, size_t index) {
+    return (static_cast<std::int64_t>(rank) << 40) | static_cast<std::int64_t>(index);
+}
+
+// Payload derived from a row ID
+inline void fill_payload(std::int64_t& payload, std::int64_t row_id) {
+    payload = row_id;
+}
+
+template <size_t N>
+inline void fill_payload(FixedPayload<N>& payload, std::int64_t row_id) {
+    for (size_t b = 0; b < N; ++b) {
+        payload.bytes[b] = static_cast<unsigned char>(row_id >> (8 * (b % 8)));
+    }
+}
+
+template <typename T>
+inline void attach_payload(T&, std::int64_t) {}
+
+template <typename K, typename P>
+inline void attach_payload(KeyValue<K, P>& element, std::int64_t row_id) {
+    fill_payload(element.value, row_id);
+}
+
+} // namespace
+
+template <typename T>
+void generate_random_data(std::vector<T>& data, unsigned int seed, int rank,
+                          size_t first_index) {
+    using K = typename SortTraits<T>::key_type;
+    
     // Use rank-specific seed for reproducibility while ensuring different data per rank
-    std::mt19937 gen(seed + rank * 12345);
-    std::uniform_int_distribution<int> dis(0, 1000000000);
+    std::mt19937_64 gen(seed + rank * 12345);
+    KeyDistribution<K> dis;
     
     for (size_t i = 0; i < data.size(); ++i) {
-        data[i] = dis(gen);
+        data[i] = SortTraits<T>::make(dis(gen));
+        attach_payload(data[i], global_row_id(rank, first_index + i));
     }
 }
 
-void generate_uniform_data(std::vector<int>& data, int rank) {
+template <typename T>
+void generate_uniform_data(std::vector<T>& data, int rank) {
+    using K = typename SortTraits<T>::key_type;
+    
     for (size_t i = 0; i < data.size(); ++i) {
-        data[i] = static_cast<int>(rank * data.size() + i);
+        data[i] = SortTraits<T>::make(static_cast<K>(rank * data.size() + i));
+        attach_payload(data[i], global_row_id(rank, i));
+    }
+}
+
+namespace {
+
+// Width of the key range the shaped distributions draw from
+constexpr double KEY_RANGE = 1e9;
+
+// Distinct values of the Zipf distribution and its exponent
+constexpr size_t ZIPF_VALUES = 1 << 20;
+constexpr double ZIPF_EXPONENT = 1.0;
+
+// Fraction of elements displaced in nearly sorted input
+constexpr double NEARLY_SORTED_SWAPS = 0.01;
+
+// Zipf sampler: the value of rank k (1-based) has weight 1 / k^s; value k
+// maps to key k * KEY_RANGE / ZIPF_VALUES, so key 0 is never drawn and the
+// hottest key is the smallest
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+    std::uniform_real_distribution<double> uniform{0.0, 1.0};
+    
+public:
+    ZipfSampler() : cdf(ZIPF_VALUES) {
+        double sum = 0;
+        for (size_t k = 0; k < ZIPF_VALUES; ++k) {
+            sum += 1.0 / std::pow(static_cast<double>(k + 1), ZIPF_EXPONENT);
+            cdf[k] = sum;
+        }
+        for (double& c : cdf) c /= sum;
+    }
+    
+    double operator()(std::mt19937_64& gen) {
+        size_t k = std::lower_bound(cdf.begin(), cdf.end(), uniform(gen)) - cdf.begin();
+        k = std::min(k, ZIPF_VALUES - 1);
+        return (k + 1) * (KEY_RANGE / ZIPF_VALUES);
+    }
+};
+
+template <typename T>
+inline T make_element(double key, int rank, size_t index) {
+    using K = typename SortTraits<T>::key_type;
+    T element = SortTraits<T>::make(static_cast<K>(key));
+    attach_payload(element, global_row_id(rank, index));
+    return element;
+}
+
+} // namespace
+
+template <typename T>
+void generate_data(std::vector<T>& data, InputDistribution distribution,
+                   unsigned int seed, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    
+    if (distribution == InputDistribution::Random) {
+        generate_random_data(data, seed, rank);
+        return;
+    }
+    
+    // Position of this rank's block in the global input
+    unsigned long long local_count = data.size();
+    unsigned long long offset = 0;
+    unsigned long long total = 0;
+    MPI_Exscan(&local_count, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&local_count, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) offset = 0;
+    
+    std::mt19937_64 gen(seed + rank * 12345);
+    size_t n = data.size();
+    
+    switch (distribution) {
+        case InputDistribution::Zipf: {
+            ZipfSampler zipf;
+            for (size_t i = 0; i < n; ++i) {
+                data[i] = make_element<T>(zipf(gen), rank, i);
+            }
+            break;
+        }
+        case InputDistribution::Gaussian: {
+            std::normal_distribution<double> normal(KEY_RANGE / 2, KEY_RANGE / 10);
+            for (size_t i = 0; i < n; ++i) {
+                double key = std::min(std::max(std::round(normal(gen)), 0.0), KEY_RANGE);
+                data[i] = make_element<T>(key, rank, i);
+            }
+            break;
+        }
+        case InputDistribution::AllEqual:
+            for (size_t i = 0; i < n; ++i) {
+                data[i] = make_element<T>(42, rank, i);
+            }
+            break;
+        case InputDistribution::Sorted:
+        case InputDistribution::NearlySorted:
+            for (size_t i = 0; i < n; ++i) {
+                data[i] = make_element<T>(static_cast<double>(offset + i), rank, i);
+            }
+            if (distribution == InputDistribution::NearlySorted && n > 1) {
+                // Swap random pairs of elements within the rank's block
+                std::uniform_int_distribution<size_t> position(0, n - 1);
+                size_t swaps = static_cast<size_t>(n * NEARLY_SORTED_SWAPS / 2);
+                for (size_t s = 0; s < swaps; ++s) {
+                    std::swap(data[position(gen)], data[position(gen)]);
+                }
+            }
+            break;
+        case InputDistribution::ReverseSorted:
+            for (size_t i = 0; i < n; ++i) {
+                data[i] = make_element<T>(static_cast<double>(total - 1 - (offset + i)), rank, i);
+            }
+            break;
+        case InputDistribution::Staggered: {
+            // Helman-Bader-JaJa staggered input: the first half of the ranks
+            // draw from the odd key blocks, the second half from the even ones
+            int half = size / 2;
+            int block = (rank < half) ? 2 * rank + 1 : 2 * (rank - half);
+            block %= size;
+            double width = KEY_RANGE / size;
+            std::uniform_real_distribution<double> within(0.0, width);
+            for (size_t i = 0; i < n; ++i) {
+                double key = std::floor(block * width + within(gen));
+                data[i] = make_element<T>(key, rank, i);
+            }
+            break;
+        }
+        case InputDistribution::Random:
+            break;
     }
 }
 
-bool is_locally_sorted(const std::vector<int>& data) {
+template <typename P>
+void generate_payloads(std::vector<P>& payloads, int rank) {
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        fill_payload(payloads[i], global_row_id(rank, i));
+    }
+}
+
+template <typename T>
+bool is_locally_sorted(const std::vector<T>& data) {
     for (size_t i = 1; i < data.size(); ++i) {
         if (data[i] < data[i-1]) {
             return false;
@@ -35,45 +240,154 @@ bool is_locally_sorted(const std::vector<int>& data) {
     return true;
 }
 
-bool verify_sorted(const std::vector<int>& data, int rank, int size, MPI_Comm comm) {
+template <typename T>
+bool verify_sorted(const std::vector<T>& data, int rank, int size, MPI_Comm comm) {
     // Check local sorting
+    bool local_ok = true;
     if (!is_locally_sorted(data)) {
-        if (rank == 0) {
-            std::cerr << "Rank " << rank << ": Local data not sorted!" << std::endl;
-        }
-        return false;
+        std::cerr << "Rank " << rank << ": Local data not sorted!" << std::endl;
+        local_ok = false;
     }
     
-    // Check boundary conditions between ranks
-    int last_elem = data.empty() ? INT_MIN : data.back();
-    int next_first_elem;
-    
-    if (rank < size - 1) {
-        MPI_Send(&last_elem, 1, MPI_INT, rank + 1, 0, comm);
+    if (data.empty()) {
+        return verify_rank_boundaries(local_ok, false, T(), T(), rank, size, comm);
     }
+    return verify_rank_boundaries(local_ok, true, data.front(), data.back(), rank, size, comm);
+}
+
+template <typename T>
+bool verify_rank_boundaries(bool local_ok, bool has_data, const T& first, const T& last,
+                            int rank, int size, MPI_Comm comm) {
+    // Share every rank's first and last element so empty ranks can be
+    // skipped when checking boundaries
+    struct Boundary {
+        int has_data;
+        T first;
+        T last;
+    };
+    Boundary local_boundary;
+    std::memset(static_cast<void*>(&local_boundary), 0, sizeof(local_boundary));
+    local_boundary.has_data = has_data;
+    if (has_data) {
+        local_boundary.first = first;
+        local_boundary.last = last;
+    }
+    std::vector<Boundary> boundaries(size);
+    MPI_Allgather(&local_boundary, sizeof(Boundary), MPI_BYTE,
+                  boundaries.data(), sizeof(Boundary), MPI_BYTE, comm);
     
-    if (rank > 0) {
-        int prev_last_elem;
-        MPI_Recv(&prev_last_elem, 1, MPI_INT, rank - 1, 0, comm, MPI_STATUS_IGNORE);
-        
-        if (!data.empty() && data[0] < prev_last_elem) {
-            std::cerr << "Rank " << rank << ": Boundary condition violated! "
-                      << "Previous rank last: " << prev_last_elem 
-                      << ", Current rank first: " << data[0] << std::endl;
-            return false;
+    // Check boundary conditions against the nearest non-empty lower rank
+    int ok = local_ok;
+    if (has_data) {
+        for (int r = rank - 1; r >= 0; --r) {
+            if (!boundaries[r].has_data) continue;
+            if (first < boundaries[r].last) {
+                std::cerr << "Rank " << rank << ": Boundary condition violated with rank "
+                          << r << std::endl;
+                ok = 0;
+            }
+            break;
         }
     }
     
     // Gather results
-    int local_ok = 1;
     int global_ok;
-    MPI_Allreduce(&local_ok, &global_ok, 1, MPI_INT, MPI_LAND, comm);
+    MPI_Allreduce(&ok, &global_ok, 1, MPI_INT, MPI_LAND, comm);
     
     return global_ok == 1;
 }
 
+#define INSTANTIATE_UTILS(T) \
+    template void generate_random_data<T>(std::vector<T>&, unsigned int, int, size_t); \
+    template void generate_uniform_data<T>(std::vector<T>&, int); \
+    template void generate_data<T>(std::vector<T>&, InputDistribution, unsigned int, MPI_Comm); \
+    template bool verify_sorted<T>(const std::vector<T>&, int, int, MPI_Comm); \
+    template bool verify_rank_boundaries<T>(bool, bool, const T&, const T&, int, int, MPI_Comm); \
+    template bool is_locally_sorted<T>(const std::vector<T>&);
+FOR_EACH_SORT_TYPE(INSTANTIATE_UTILS)
+
+template void generate_payloads<std::int64_t>(std::vector<std::int64_t>&, int);
+template void generate_payloads<FixedPayload<56>>(std::vector<FixedPayload<56>>&, int);
+
+TimingData reduce_timing(const TimingData& timing, MPI_Comm comm) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    
+    // Slowest rank
+    double local_max[3] = {timing.total_time, timing.read_time, timing.write_time};
+    double global_max[3];
+    MPI_Reduce(local_max, global_max, 3, MPI_DOUBLE, MPI_MAX, 0, comm);
+    
+    // Rank averages
+    double local_sum[6] = {timing.local_sort_time, timing.comm_time, timing.merge_time,
+                           timing.overlap_time, timing.other_time, timing.io_time};
+    double global_sum[6];
+    MPI_Reduce(local_sum, global_sum, 6, MPI_DOUBLE, MPI_SUM, 0, comm);
+    
+    unsigned long long local_counts[3] = {timing.padding_elements, timing.bytes_exchanged,
+                                          timing.spill_bytes};
+    unsigned long long global_counts[3];
+    MPI_Reduce(local_counts, global_counts, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+    
+    long long local_peaks[5] = {timing.idle_steps, timing.splitter_rounds,
+                                static_cast<long long>(timing.output_elements),
+                                timing.splitters_reused, timing.rebalanced};
+    long long global_peaks[5];
+    MPI_Reduce(local_peaks, global_peaks, 5, MPI_LONG_LONG, MPI_MAX, 0, comm);
+    
+    // Heap and RSS: bytes allocated add up, peaks are the worst rank's
+    unsigned long long local_allocated[4] = {timing.local_sort_counts.allocated_bytes,
+                                             timing.comm_counts.allocated_bytes,
+                                             timing.merge_counts.allocated_bytes,
+                                             timing.total_counts.allocated_bytes};
+    unsigned long long global_allocated[4];
+    MPI_Reduce(local_allocated, global_allocated, 4, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, comm);
+    
+    unsigned long long local_memory_peaks[5] = {timing.local_sort_counts.peak_heap_bytes,
+                                                timing.comm_counts.peak_heap_bytes,
+                                                timing.merge_counts.peak_heap_bytes,
+                                                timing.total_counts.peak_heap_bytes,
+                                                timing.peak_rss_bytes};
+    unsigned long long global_memory_peaks[5];
+    MPI_Reduce(local_memory_peaks, global_memory_peaks, 5, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, comm);
+    
+    TimingData summary;
+    MPI_Reduce(timing.local_sort_counts.perf.values, summary.local_sort_counts.perf.values,
+               NUM_PERF_EVENTS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(timing.comm_counts.perf.values, summary.comm_counts.perf.values,
+               NUM_PERF_EVENTS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(timing.merge_counts.perf.values, summary.merge_counts.perf.values,
+               NUM_PERF_EVENTS, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    PhaseCounts* phases[4] = {&summary.local_sort_counts, &summary.comm_counts,
+                              &summary.merge_counts, &summary.total_counts};
+    for (int i = 0; i < 4; ++i) {
+        phases[i]->allocated_bytes = global_allocated[i];
+        phases[i]->peak_heap_bytes = global_memory_peaks[i];
+    }
+    summary.peak_rss_bytes = global_memory_peaks[4];
+    summary.total_time = global_max[0];
+    summary.read_time = global_max[1];
+    summary.write_time = global_max[2];
+    summary.local_sort_time = global_sum[0] / size;
+    summary.comm_time = global_sum[1] / size;
+    summary.merge_time = global_sum[2] / size;
+    summary.overlap_time = global_sum[3] / size;
+    summary.other_time = global_sum[4] / size;
+    summary.io_time = global_sum[5] / size;
+    summary.padding_elements = global_counts[0];
+    summary.bytes_exchanged = global_counts[1];
+    summary.spill_bytes = global_counts[2];
+    summary.idle_steps = global_peaks[0];
+    summary.splitter_rounds = global_peaks[1];
+    summary.output_elements = global_peaks[2];
+    summary.splitters_reused = global_peaks[3];
+    summary.rebalanced = global_peaks[4];
+    return summary;
+}
+
 void write_results_csv(const std::string& filename, const BenchmarkConfig& config,
-                       const TimingData& timing, int rank, int size, int iteration) {
+                       const SortConfig& sort_config, const TimingData& summary,
+                       int rank, int size, int iteration, bool verified) {
     if (rank != 0) return;  // Only root writes
     
     std::ofstream file;
@@ -83,74 +397,343 @@ void write_results_csv(const std::string& filename, const BenchmarkConfig& confi
     
     // Write header if file is new
     if (!file_exists) {
-        file << "timestamp,algorithm,ranks,total_size,per_rank_size,iteration,"
-             << "total_time,local_sort_time,comm_time,merge_time,other_time,verified\n";
+        file << "num_ranks,problem_size,total_time,local_sort_time,communication_time,merge_time,"
+             << "threads_per_rank,local_sort,pipeline_chunk,overlap_time,other_time,"
+             << "key_type,payload,layout,bytes_exchanged,splitters,splitter_rounds,"
+             << "max_output,output_imbalance,distribution,memory_budget,io_time,spill_bytes,"
+             << "read_time,write_time,iteration,verified,exchange,oversampling";
+        for (const char* phase : {"local_sort", "comm", "merge"}) {
+            for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+                file << "," << phase << "_" << perf_event_name(e);
+            }
+        }
+        file << ",low_memory,peak_rss_bytes,peak_heap_bytes";
+        for (const char* phase : {"local_sort", "comm", "merge"}) {
+            file << "," << phase << "_peak_bytes," << phase << "_alloc_bytes";
+        }
+        file << ",plan,splitters_reused";
+        file << ",batch_size,rebalanced";
+        file << ",queries";
+        file << ",algorithm,auto_tuned";
+        file << "\n";
     }
     
-    size_t per_rank_size = config.total_size / size;
+    // Incremental runs: the resident array holds the initial elements plus
+    // every batch so far, warmups included
+    double resident_total = config.total_size + static_cast<double>(config.incremental_batch)
+                          * (config.warmup_iterations + iteration + 1);
+    double ideal_output = resident_total / size;
+    double output_imbalance = ideal_output > 0 ? summary.output_elements / ideal_output : 1.0;
+    const char* distribution = config.input_file.empty()
+                             ? input_distribution_name(config.distribution) : "file";
+    const char* verification = !config.verify ? "skipped" : (verified ? "passed" : "failed");
+    // Select runs: quantiles asked for, or k for top-k
+    long long queries = config.algorithm != "select" ? 0
+                      : (config.top_k > 0 ? config.top_k
+                                          : static_cast<long long>(config.quantiles.size()));
     
-    file << get_timestamp() << ","
-         << config.algorithm << ","
-         << size << ","
+    file << size << ","
          << config.total_size << ","
-         << per_rank_size << ","
+         << summary.total_time << ","
+         << summary.local_sort_time << ","
+         << summary.comm_time << ","
+         << summary.merge_time << ","
+         << sort_config.threads_per_rank << ","
+         << local_sort_engine_name(sort_config.local_sort) << ","
+         << sort_config.pipeline_chunk << ","
+         << summary.overlap_time << ","
+         << summary.other_time << ","
+         << config.key_type << ","
+         << config.payload << ","
+         << config.layout << ","
+         << summary.bytes_exchanged << ","
+         << splitter_method_name(sort_config.splitters) << ","
+         << summary.splitter_rounds << ","
+         << summary.output_elements << ","
+         << output_imbalance << ","
+         << distribution << ","
+         << sort_config.memory_budget << ","
+         << summary.io_time << ","
+         << summary.spill_bytes << ","
+         << summary.read_time << ","
+         << summary.write_time << ","
          << iteration << ","
-         << std::fixed << std::setprecision(6)
-         << timing.total_time << ","
-         << timing.local_sort_time << ","
-         << timing.comm_time << ","
-         << timing.merge_time << ","
-         << timing.other_time << ","
-         << (config.verify ? "true" : "false") << "\n";
+         << verification << ","
+         << exchange_method_name(sort_config.exchange) << ","
+         << sort_config.oversampling;
+    for (const PhaseCounts* counts : {&summary.local_sort_counts, &summary.comm_counts,
+                                      &summary.merge_counts}) {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+            file << "," << counts->perf.values[e];
+        }
+    }
+    file << "," << (sort_config.low_memory ? 1 : 0)
+         << "," << summary.peak_rss_bytes
+         << "," << summary.total_counts.peak_heap_bytes;
+    for (const PhaseCounts* counts : {&summary.local_sort_counts, &summary.comm_counts,
+                                      &summary.merge_counts}) {
+        file << "," << counts->peak_heap_bytes << "," << counts->allocated_bytes;
+    }
+    file << "," << (config.use_plan ? 1 : 0) << "," << summary.splitters_reused;
+    file << "," << config.incremental_batch << "," << summary.rebalanced;
+    file << "," << queries;
+    file << "," << config.algorithm << "," << (config.auto_tune ? 1 : 0);
+    file << "\n";
     
     file.close();
 }
 
-void print_statistics(const TimingData& timing, int rank, int size, MPI_Comm comm) {
-    // Gather timing data from all ranks
-    std::vector<double> all_total(size);
-    std::vector<double> all_local_sort(size);
-    std::vector<double> all_comm(size);
-    std::vector<double> all_merge(size);
-    
-    MPI_Gather(&timing.total_time, 1, MPI_DOUBLE, all_total.data(), 1, MPI_DOUBLE, 0, comm);
-    MPI_Gather(&timing.local_sort_time, 1, MPI_DOUBLE, all_local_sort.data(), 1, MPI_DOUBLE, 0, comm);
-    MPI_Gather(&timing.comm_time, 1, MPI_DOUBLE, all_comm.data(), 1, MPI_DOUBLE, 0, comm);
-    MPI_Gather(&timing.merge_time, 1, MPI_DOUBLE, all_merge.data(), 1, MPI_DOUBLE, 0, comm);
-    
-    if (rank == 0) {
-        auto calc_stats = [](const std::vector<double>& vec) {
-            double mean = std::accumulate(vec.begin(), vec.end(), 0.0) / vec.size();
-            double sq_sum = 0.0;
-            for (double v : vec) {
-                sq_sum += (v - mean) * (v - mean);
+namespace {
+
+struct SampleStats {
+    double mean, stddev, min, median, p95;
+};
+
+// Sample statistics; p95 is the nearest-rank percentile
+SampleStats sample_stats(std::vector<double> values) {
+    SampleStats stats = {0, 0, 0, 0, 0};
+    size_t n = values.size();
+    if (n == 0) return stats;
+    std::sort(values.begin(), values.end());
+    stats.mean = std::accumulate(values.begin(), values.end(), 0.0) / n;
+    double sq_sum = 0.0;
+    for (double v : values) {
+        sq_sum += (v - stats.mean) * (v - stats.mean);
+    }
+    stats.stddev = n > 1 ? std::sqrt(sq_sum / (n - 1)) : 0.0;
+    stats.min = values.front();
+    stats.median = (n % 2 == 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+    size_t p95_rank = static_cast<size_t>(std::ceil(0.95 * n));
+    stats.p95 = values[std::max<size_t>(p95_rank, 1) - 1];
+    return stats;
+}
+
+void print_stats_row(const char* label, const SampleStats& stats) {
+    std::cout << std::left << std::setw(18) << label << std::right
+              << std::setw(11) << stats.mean
+              << std::setw(11) << stats.stddev
+              << std::setw(11) << stats.min
+              << std::setw(11) << stats.median
+              << std::setw(11) << stats.p95 << "\n";
+}
+
+} // namespace
+
+void print_statistics(const std::vector<TimingData>& runs, int rank, int size, MPI_Comm comm) {
+    // Gather every rank's phase times of every run: [rank][run][phase]
+    constexpr int PHASES = 4;
+    int num_runs = runs.size();
+    std::vector<double> local_times(num_runs * PHASES);
+    for (int r = 0; r < num_runs; ++r) {
+        local_times[r * PHASES + 0] = runs[r].total_time;
+        local_times[r * PHASES + 1] = runs[r].local_sort_time;
+        local_times[r * PHASES + 2] = runs[r].comm_time;
+        local_times[r * PHASES + 3] = runs[r].merge_time;
+    }
+    std::vector<double> all_times(rank == 0 ? size * local_times.size() : 0);
+    MPI_Gather(local_times.data(), local_times.size(), MPI_DOUBLE,
+               all_times.data(), local_times.size(), MPI_DOUBLE, 0, comm);
+    
+    if (rank != 0 || num_runs == 0) return;
+    
+    auto at = [&](int p, int r, int phase) {
+        return all_times[(static_cast<size_t>(p) * num_runs + r) * PHASES + phase];
+    };
+    const char* labels[PHASES] = {"Total", "Local sort", "Communication", "Merge/Partition"};
+    
+    // Per run: slowest rank for the total, rank average for the phases
+    std::vector<SampleStats> across_runs(PHASES);
+    for (int phase = 0; phase < PHASES; ++phase) {
+        std::vector<double> values(num_runs, 0.0);
+        for (int r = 0; r < num_runs; ++r) {
+            for (int p = 0; p < size; ++p) {
+                values[r] = (phase == 0) ? std::max(values[r], at(p, r, phase))
+                                         : values[r] + at(p, r, phase) / size;
             }
-            double stddev = std::sqrt(sq_sum / vec.size());
-            double max_val = *std::max_element(vec.begin(), vec.end());
-            return std::make_tuple(mean, stddev, max_val);
-        };
-        
-        auto [mean_total, std_total, max_total] = calc_stats(all_total);
-        auto [mean_local, std_local, max_local] = calc_stats(all_local_sort);
-        auto [mean_comm, std_comm, max_comm] = calc_stats(all_comm);
-        auto [mean_merge, std_merge, max_merge] = calc_stats(all_merge);
-        
-        std::cout << "\n=== Timing Statistics (across all ranks) ===" << std::endl;
-        std::cout << std::fixed << std::setprecision(4);
-        std::cout << "Total Time:      " << mean_total << " ± " << std_total 
-                  << " s (max: " << max_total << " s)" << std::endl;
-        std::cout << "Local Sort:      " << mean_local << " ± " << std_local 
-                  << " s (max: " << max_local << " s)" << std::endl;
-        std::cout << "Communication:   " << mean_comm << " ± " << std_comm 
-                  << " s (max: " << max_comm << " s)" << std::endl;
-        std::cout << "Merge/Partition: " << mean_merge << " ± " << std_merge 
-                  << " s (max: " << max_merge << " s)" << std::endl;
-        
-        double comm_percentage = (mean_comm / mean_total) * 100.0;
-        std::cout << "\nCommunication overhead: " << comm_percentage << "%" << std::endl;
-        double load_imbalance = (std_total / mean_total) * 100.0;
-        std::cout << "Load imbalance (CoV): " << load_imbalance << "%" << std::endl;
+        }
+        across_runs[phase] = sample_stats(values);
+    }
+    
+    // Per rank: mean over the runs
+    std::vector<SampleStats> across_ranks(PHASES);
+    for (int phase = 0; phase < PHASES; ++phase) {
+        std::vector<double> values(size, 0.0);
+        for (int p = 0; p < size; ++p) {
+            for (int r = 0; r < num_runs; ++r) {
+                values[p] += at(p, r, phase) / num_runs;
+            }
+        }
+        across_ranks[phase] = sample_stats(values);
+    }
+    
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(5);
+    
+    std::cout << "\n=== Timing Statistics (s) ===\n";
+    std::cout << std::left << std::setw(18) << "" << std::right
+              << std::setw(11) << "mean" << std::setw(11) << "stddev" << std::setw(11) << "min"
+              << std::setw(11) << "median" << std::setw(11) << "p95" << "\n";
+    std::cout << "Across " << num_runs << " timed runs (total: slowest rank, phases: rank average)\n";
+    for (int phase = 0; phase < PHASES; ++phase) {
+        print_stats_row(labels[phase], across_runs[phase]);
+    }
+    std::cout << "Across " << size << " ranks (each rank's mean over the runs)\n";
+    for (int phase = 0; phase < PHASES; ++phase) {
+        print_stats_row(labels[phase], across_ranks[phase]);
+    }
+    
+    std::cout << std::setprecision(2);
+    double mean_total = across_ranks[0].mean;
+    if (mean_total > 0) {
+        double comm_percentage = (across_ranks[2].mean / mean_total) * 100.0;
+        std::cout << "\nCommunication overhead: " << comm_percentage << "%\n";
+        double load_imbalance = (across_ranks[0].stddev / mean_total) * 100.0;
+        std::cout << "Load imbalance (CoV): " << load_imbalance << "%\n";
+    }
+    std::cout << std::endl;
+    
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+bool parse_local_sort_engine(const std::string& name, LocalSortEngine& engine) {
+    if (name == "std") {
+        engine = LocalSortEngine::StdSort;
+    } else if (name == "radix") {
+        engine = LocalSortEngine::Radix;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* local_sort_engine_name(LocalSortEngine engine) {
+    switch (engine) {
+        case LocalSortEngine::Radix: return "radix";
+        case LocalSortEngine::StdSort: break;
+    }
+    return "std";
+}
+
+bool parse_input_distribution(const std::string& name, InputDistribution& distribution) {
+    if (name == "random") {
+        distribution = InputDistribution::Random;
+    } else if (name == "zipf") {
+        distribution = InputDistribution::Zipf;
+    } else if (name == "gaussian") {
+        distribution = InputDistribution::Gaussian;
+    } else if (name == "equal") {
+        distribution = InputDistribution::AllEqual;
+    } else if (name == "sorted") {
+        distribution = InputDistribution::Sorted;
+    } else if (name == "reverse") {
+        distribution = InputDistribution::ReverseSorted;
+    } else if (name == "nearly-sorted") {
+        distribution = InputDistribution::NearlySorted;
+    } else if (name == "staggered") {
+        distribution = InputDistribution::Staggered;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* input_distribution_name(InputDistribution distribution) {
+    switch (distribution) {
+        case InputDistribution::Zipf: return "zipf";
+        case InputDistribution::Gaussian: return "gaussian";
+        case InputDistribution::AllEqual: return "equal";
+        case InputDistribution::Sorted: return "sorted";
+        case InputDistribution::ReverseSorted: return "reverse";
+        case InputDistribution::NearlySorted: return "nearly-sorted";
+        case InputDistribution::Staggered: return "staggered";
+        case InputDistribution::Random: break;
+    }
+    return "random";
+}
+
+bool parse_byte_size(const std::string& text, size_t& bytes) {
+    if (text.empty()) return false;
+    size_t digits = 0;
+    while (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits]))) {
+        digits++;
+    }
+    if (digits == 0) return false;
+    
+    size_t multiplier = 1;
+    std::string suffix = text.substr(digits);
+    if (suffix == "K" || suffix == "k") {
+        multiplier = size_t(1) << 10;
+    } else if (suffix == "M" || suffix == "m") {
+        multiplier = size_t(1) << 20;
+    } else if (suffix == "G" || suffix == "g") {
+        multiplier = size_t(1) << 30;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    bytes = std::stoull(text.substr(0, digits)) * multiplier;
+    return true;
+}
+
+bool parse_fraction_list(const std::string& text, std::vector<double>& fractions) {
+    fractions.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(start, end - start);
+        char* rest = nullptr;
+        double value = std::strtod(item.c_str(), &rest);
+        if (item.empty() || *rest != '\0' || !(value >= 0.0 && value <= 1.0)) return false;
+        fractions.push_back(value);
+        start = end + 1;
+    }
+    return !fractions.empty();
+}
+
+bool parse_splitter_method(const std::string& name, SplitterMethod& method) {
+    if (name == "regular") {
+        method = SplitterMethod::Regular;
+    } else if (name == "histogram") {
+        method = SplitterMethod::Histogram;
+    } else if (name == "distributed") {
+        method = SplitterMethod::Distributed;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* splitter_method_name(SplitterMethod method) {
+    switch (method) {
+        case SplitterMethod::Histogram: return "histogram";
+        case SplitterMethod::Distributed: return "distributed";
+        case SplitterMethod::Regular: break;
+    }
+    return "regular";
+}
+
+bool parse_exchange_method(const std::string& name, ExchangeMethod& method) {
+    if (name == "flat") {
+        method = ExchangeMethod::Flat;
+    } else if (name == "hierarchical") {
+        method = ExchangeMethod::Hierarchical;
+    } else if (name == "shared") {
+        method = ExchangeMethod::Shared;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* exchange_method_name(ExchangeMethod method) {
+    switch (method) {
+        case ExchangeMethod::Hierarchical: return "hierarchical";
+        case ExchangeMethod::Shared: return "shared";
+        case ExchangeMethod::Flat: break;
     }
+    return "flat";
 }
 
 std::string get_timestamp() {
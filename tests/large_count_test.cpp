@@ -0,0 +1,209 @@
+/**
+ * Tests for large_count.h against the plain int-count MPI routines
+ *
+ * 1. Large datatype: rank 0 sends rank 1 2049 elements of a 1 MiB
+ *    contiguous type, so the per-peer count fits an int but its bytes
+ *    (2^31 + 2^20) exceed INT_MAX. The send buffer is left untouched apart
+ *    from two stamps per element, so it costs a few pages; only rank 1's
+ *    receive buffer is resident.
+ * 2. Split messages: an uneven int exchange and a mirrored large_sendrecv
+ *    whose counts are a few times max_message_elements(), and a small
+ *    exchange of 1 MiB elements between all ranks. Built with
+ *    -DMAX_MESSAGE_ELEMENTS=1000 (the large_count_split_test target),
+ *    these and case 1 run the split Isend/Irecv path.
+ *
+ * large_count.cpp is compiled into the test so it can instantiate the
+ * exchanges for the 1 MiB type and take the build's MAX_MESSAGE_ELEMENTS.
+ * Every result is compared with MPI_Alltoallv or MPI_Sendrecv into a
+ * buffer filled with a different pattern. Run on at least two ranks.
+ */
+#include "../src/large_count.cpp"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+
+namespace {
+
+using Block = FixedPayload<1 << 20>;
+
+// Per-peer count of the large datatype case: 2049 MiB
+constexpr long long BIG_BLOCKS = 2049;
+
+// Stamp an element with its origin: the first and last word of a block
+void stamp(Block& block, std::uint64_t tag) {
+    std::memcpy(block.bytes, &tag, sizeof(tag));
+    std::memcpy(block.bytes + sizeof(Block) - sizeof(tag), &tag, sizeof(tag));
+}
+
+void stamp(int& value, std::uint64_t tag) {
+    value = static_cast<int>(tag ^ (tag >> 32));
+}
+
+std::uint64_t element_tag(int rank, long long index) {
+    return (static_cast<std::uint64_t>(rank) << 40) + static_cast<std::uint64_t>(index) + 1;
+}
+
+// FNV-1a over 64-bit words of every element
+template <typename T>
+std::uint64_t hash_elements(const T* data, size_t count) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t words = count * sizeof(T) / sizeof(std::uint64_t);
+    std::uint64_t hash = 14695981039346656037ull;
+    for (size_t w = 0; w < words; ++w) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + w * sizeof(word), sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (size_t b = words * sizeof(std::uint64_t); b < count * sizeof(T); ++b) {
+        hash = (hash ^ bytes[b]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Prefix sums of counts
+std::vector<long long> displacements(const std::vector<long long>& counts) {
+    std::vector<long long> displs(counts.size(), 0);
+    for (size_t r = 1; r < counts.size(); ++r) {
+        displs[r] = displs[r - 1] + counts[r - 1];
+    }
+    return displs;
+}
+
+// Elements of T without initialization, so untouched pages stay unmapped
+template <typename T>
+std::unique_ptr<T[]> uninitialized(long long count) {
+    return std::unique_ptr<T[]>(new T[std::max<long long>(count, 1)]);
+}
+
+/**
+ * large_alltoallv against MPI_Alltoallv for the given send counts. Every
+ * element is stamped with its origin (stamp()), the rest of a block is
+ * left as allocated. True on every rank when all results match.
+ */
+template <typename T>
+bool check_alltoallv(const std::vector<long long>& send_counts, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    std::vector<long long> recv_counts(size);
+    MPI_Alltoall(send_counts.data(), 1, MPI_LONG_LONG, recv_counts.data(), 1, MPI_LONG_LONG, comm);
+    std::vector<long long> send_displs = displacements(send_counts);
+    std::vector<long long> recv_displs = displacements(recv_counts);
+    long long send_total = std::accumulate(send_counts.begin(), send_counts.end(), 0LL);
+    long long recv_total = std::accumulate(recv_counts.begin(), recv_counts.end(), 0LL);
+
+    std::unique_ptr<T[]> send = uninitialized<T>(send_total);
+    std::unique_ptr<T[]> recv = uninitialized<T>(recv_total);
+    for (long long i = 0; i < send_total; ++i) {
+        stamp(send[i], element_tag(rank, i));
+    }
+
+    // Reference through the int-count routine; these counts fit an int
+    MPI_Datatype type = mpi_type<T>();
+    std::vector<int> sc(send_counts.begin(), send_counts.end());
+    std::vector<int> sd(send_displs.begin(), send_displs.end());
+    std::vector<int> rc(recv_counts.begin(), recv_counts.end());
+    std::vector<int> rd(recv_displs.begin(), recv_displs.end());
+    std::memset(static_cast<void*>(recv.get()), 0x5a, recv_total * sizeof(T));
+    MPI_Alltoallv(send.get(), sc.data(), sd.data(), type,
+                  recv.get(), rc.data(), rd.data(), type, comm);
+    std::vector<std::uint64_t> expected(size);
+    for (int r = 0; r < size; ++r) {
+        expected[r] = hash_elements(recv.get() + recv_displs[r], recv_counts[r]);
+    }
+
+    std::memset(static_cast<void*>(recv.get()), 0xa5, recv_total * sizeof(T));
+    large_alltoallv(send.get(), send_counts, send_displs,
+                    recv.get(), recv_counts, recv_displs, comm);
+    int local_ok = 1;
+    for (int r = 0; r < size; ++r) {
+        if (hash_elements(recv.get() + recv_displs[r], recv_counts[r]) != expected[r]) {
+            std::cerr << "Rank " << rank << ": run from rank " << r << " differs" << std::endl;
+            local_ok = 0;
+        }
+    }
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_LAND, comm);
+    return ok == 1;
+}
+
+// large_sendrecv against MPI_Sendrecv with the neighbour rank ^ 1
+bool check_sendrecv(long long unit, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int partner = rank ^ 1;
+    if (partner >= size) partner = rank;
+
+    // Both sides derive the pair of counts from the lower rank
+    auto count_of = [&](int r) { return 2 * unit + 37 * r + 1; };
+    size_t send_count = count_of(rank);
+    size_t recv_count = count_of(partner);
+    std::vector<int> send(send_count);
+    std::iota(send.begin(), send.end(), rank * 100000);
+    std::vector<int> expected(recv_count, -1);
+    std::vector<int> received(recv_count, -2);
+    MPI_Sendrecv(send.data(), static_cast<int>(send_count), MPI_INT, partner, 1,
+                 expected.data(), static_cast<int>(recv_count), MPI_INT, partner, 1,
+                 comm, MPI_STATUS_IGNORE);
+    large_sendrecv(send.data(), send_count, received.data(), recv_count, partner, 2, comm);
+
+    int local_ok = received == expected;
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_LAND, comm);
+    return ok == 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    MPI_Init(&argc, &argv);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (size < 2) {
+        if (rank == 0) std::cerr << "Error: run on at least two ranks" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+
+    int failures = 0;
+    auto report = [&](const std::string& name, bool passed) {
+        if (!passed) failures++;
+        if (rank == 0) {
+            std::cout << name << ": " << (passed ? "PASSED" : "FAILED") << std::endl;
+        }
+    };
+
+    // Counts a few times the message limit, but never beyond one int call
+    long long unit = std::min<long long>(static_cast<long long>(max_message_elements()), 1000);
+    if (rank == 0) {
+        std::cout << "Message limit: " << max_message_elements() << " elements" << std::endl;
+    }
+
+    std::vector<long long> int_counts(size);
+    for (int r = 0; r < size; ++r) {
+        int_counts[r] = unit * (1 + (rank + r) % 3) + 7 * rank + r;
+    }
+    report("alltoallv int, uneven", check_alltoallv<int>(int_counts, MPI_COMM_WORLD));
+
+    std::vector<long long> block_counts(size);
+    for (int r = 0; r < size; ++r) {
+        block_counts[r] = (rank + 2 * r) % 5;
+    }
+    report("alltoallv 1 MiB blocks, small", check_alltoallv<Block>(block_counts, MPI_COMM_WORLD));
+
+    report("sendrecv int", check_sendrecv(unit, MPI_COMM_WORLD));
+
+    std::vector<long long> big_counts(size, 0);
+    if (rank == 0) big_counts[1] = BIG_BLOCKS;
+    report("alltoallv 1 MiB blocks, 2^31 + 2^20 bytes to one peer",
+           check_alltoallv<Block>(big_counts, MPI_COMM_WORLD));
+
+    MPI_Finalize();
+    return failures == 0 ? 0 : 1;
+}